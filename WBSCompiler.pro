@@ -0,0 +1,35 @@
+TEMPLATE = app
+CONFIG += c++20 console thread
+CONFIG -= qt app_bundle
+
+# Kept apart from the editor's objects since both projects build from the same sources
+OBJECTS_DIR = build/wbsc
+
+# Sources
+SOURCES += compilermain.cpp \
+           benchmarks.cpp \
+           tokenparser.cpp \
+           bytescan.cpp \
+           incrementallexer.cpp \
+           intermediatenode.cpp \
+           symboltable.cpp \
+           nodearena.cpp \
+           flattree.cpp \
+           sourcelines.cpp
+
+# Headers
+HEADERS += benchmarks.h \
+           tokenparser.h \
+           bytescan.h \
+           incrementallexer.h \
+           intermediatenode.h \
+           nodearena.h \
+           flattree.h \
+           sourcelines.h \
+           symboltable.h \
+           chunkedlist.hpp \
+           token.hpp \
+           syntaxerror.hpp \
+           notimplementedexception.hpp
+
+TARGET = wbsc
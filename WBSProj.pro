@@ -8,14 +8,29 @@ SOURCES += main.cpp \
            editorwindow.cpp \
            syntaxhighlighter.cpp \
            tokenparser.cpp \
-           intermediatenode.cpp
+           bytescan.cpp \
+           incrementallexer.cpp \
+           parseworker.cpp \
+           intermediatenode.cpp \
+           symboltable.cpp \
+           nodearena.cpp \
+           flattree.cpp \
+           sourcelines.cpp
 
 # Headers
 HEADERS += editorwindow.h \
            syntaxhighlighter.h \
            tokenparser.h \
+           bytescan.h \
+           incrementallexer.h \
+           parseworker.h \
            intermediatenode.h \
+           nodearena.h \
+           flattree.h \
+           sourcelines.h \
            binarytreehelper.hpp \
+           chunkedlist.hpp \
+           symboltable.h \
            token.hpp \
            syntaxerror.hpp \
            notimplementedexception.hpp
@@ -0,0 +1,505 @@
+/* benchmarks.cpp
+PURPOSE:
+- Synthetic inputs for timing the compiler front end from wbsc, real projects are too small to show how it scales
+*/
+#include "benchmarks.h"
+#include "bytescan.h"
+#include "tokenparser.h"
+#include "incrementallexer.h"
+#include "intermediatenode.h"
+#include "flattree.h"
+#include "sourcelines.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Benchmark {
+    const char *name;
+    const char *description;
+    size_t defaultSize;
+    std::vector<const char *> columns;
+    size_t growthColumn; // The column the benchmark is about, its growth between sizes is shown
+    std::function<std::vector<double>(size_t)> run; // Milliseconds for each column at a size
+};
+
+double millisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Tokens of the same text, so the same offset and length is the same value
+bool sameTokens(const std::vector<LexToken> &a, const std::vector<LexToken> &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+            [](const LexToken &x, const LexToken &y) { return x.offset == y.offset && x.length == y.length && x.kind == y.kind; });
+}
+
+// Lexes, builds and walks the generated text
+std::function<std::vector<double>(size_t)> frontEnd(std::function<std::string(size_t)> generate) {
+    return [generate](size_t size) {
+        std::string text = generate(size);
+        auto start = Clock::now();
+        TokenParser parser;
+        const auto &tokens = parser.lex(text);
+        double lex = millisSince(start);
+
+        start = Clock::now();
+        IntermediateNode root;
+        root.generateTree(text, tokens);
+        double tree = millisSince(start);
+
+        // A whole-tree walk, the root can end up below an operator so start from the top
+        start = Clock::now();
+        IntermediateNode *top = &root;
+        while (top->getParent() != nullptr) top = top->getParent();
+        volatile uint32_t total = top->getNumberTotal();
+        (void)total;
+        return std::vector<double>{lex, tree, millisSince(start)};
+    };
+}
+const std::vector<const char *> frontEndColumns = {"lex ms", "tree ms", "walk ms"};
+
+// A single list literal with size elements, wide lists used to parse in quadratic time
+std::string listLiteral(size_t size) {
+    std::string text = "const l = [";
+    for (size_t i = 0; i < size; ++i) text += std::to_string(i) + ", ";
+    text += "]\n";
+    return text;
+}
+
+// Top level statements are all siblings, so this is the longest sibling chain a file can make
+std::string statements(size_t size) {
+    std::string text;
+    for (size_t i = 0; i < size; ++i) text += "const a" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    return text;
+}
+
+// Lists nested size deep
+std::string nesting(size_t size) {
+    return "export " + std::string(size, '[') + std::string(size, ']') + "\n";
+}
+
+// One expression with operators at every level of precedence, each one climbs past whatever binds tighter before it
+std::string expression(size_t size) {
+    static const char *operators[] = {" + ", " * ", " ** ", " - ", " / ", " and ", " == ", " | "};
+    std::string text = "const e = 0";
+    for (size_t i = 0; i < size; ++i) text += operators[i % std::size(operators)] + std::to_string(i);
+    text += "\n";
+    return text;
+}
+
+std::vector<std::string> documentLines(size_t size) {
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < size; ++i) lines.push_back("create div(class = \"row" + std::to_string(i) + "\") // row\n");
+    return lines;
+}
+
+// Every kind of statement, size times over
+std::string mixed(size_t size) {
+    std::string text;
+    for (size_t i = 0; i < size; ++i)
+        text += "const row" + std::to_string(i) + " = [" + std::to_string(i) + ".5, #ff00aa, true, this]\n"
+                "colorset bg = #00ff00 fg = row" + std::to_string(i) + " x = false\n"
+                "foreach item in row" + std::to_string(i) + " do export item and not x\n";
+    return text;
+}
+
+// Broken input is what the editor sees most, a file while it is being typed, it has to cost no more than valid input
+
+// A run of signs each waiting on the next, the statement after has to climb back out past all of them
+std::string signs(size_t size) {
+    std::string text = "export";
+    for (size_t i = 0; i < size; ++i) text += " -";
+    return text + " x\nconst y = 1\n";
+}
+
+// A bare expression, then closing brackets with nothing open for them, each is left over as a statement of its own
+std::string strayBrackets(size_t size) {
+    std::string text = "0";
+    for (size_t i = 1; i <= size; ++i) text += " + " + std::to_string(i);
+    for (size_t i = 0; i < size; ++i) text += " )";
+    return text + "\n";
+}
+
+// Brackets left open, then closed with the wrong kind
+std::string unclosed(size_t size) {
+    return "export " + std::string(size, '(') + std::string(size, ']') + "\n";
+}
+
+// The mixed statements with every line cut off somewhere along it
+std::string halfTyped(size_t size) {
+    const std::string whole = mixed(size);
+    std::string text;
+    size_t cut = 0;
+    for (size_t start = 0, end; start < whole.size(); start = end + 1) {
+        end = whole.find('\n', start);
+        cut = (cut + 7919) % (end - start + 1);
+        text.append(whole, start, cut);
+        text += '\n';
+    }
+    return text;
+}
+
+// Machine written source, long names, strings and comments are the runs ByteScan skips over a vector at a time
+std::string generated(size_t size) {
+    const std::string filler(100, 'x');
+    std::string text;
+    for (size_t i = 0; i < size; ++i)
+        text += "// generated from block " + std::to_string(i) + " of " + filler + "\n"
+                "const generated_" + filler + std::to_string(i) + " = \"" + filler + filler + "\"\n"
+                "                                \n";
+    return text;
+}
+
+// Lexes the text at each level of ByteScan the processor has, one that it does not have is left at 0,
+        // every level has to give the same tokens as the scalar one
+std::function<std::vector<double>(size_t)> lexLevels(std::function<std::string(size_t)> generate) {
+    return [generate](size_t size) {
+        std::string text = generate(size);
+        std::vector<double> times;
+        std::vector<LexToken> scalar;
+        const ByteScan::Level best = ByteScan::getBest();
+        for (ByteScan::Level level : {ByteScan::Level::SCALAR, ByteScan::Level::SSE2, ByteScan::Level::AVX2}) {
+            if (level > best) {
+                times.push_back(0);
+                continue;
+            }
+            ByteScan::setLevel(level);
+            auto start = Clock::now();
+            TokenParser parser;
+            const std::vector<LexToken> &tokens = parser.lex(text);
+            times.push_back(millisSince(start));
+            if (level == ByteScan::Level::SCALAR) scalar = tokens;
+            else if (!sameTokens(scalar, tokens)) {
+                ByteScan::setLevel(best);
+                throw std::logic_error("lexing with a vector scan gave different tokens than the scalar one");
+            }
+        }
+        ByteScan::setLevel(best);
+        return times;
+    };
+}
+const std::vector<const char *> lexColumns = {"scalar ms", "sse2 ms", "avx2 ms"};
+
+// Strings over several lines with escaped quotes and comment marks in them, and quotes in comments,
+        // so the pieces of a parallel lex keep starting inside a string or looking like they do
+std::string multilineStrings(size_t size) {
+    std::string text;
+    for (size_t i = 0; i < size; ++i)
+        text += "const s" + std::to_string(i) + " = \"first \\\" line // still in it\n"
+                "second \\\\\" + row\n"
+                "// a comment with a \" in it\n"
+                "export \"\\\"\"\n";
+    return text;
+}
+
+// The mixed statements lexed in one go against split at line breaks across the cores, at least two even on one core.
+        // Both have to give the same tokens, strings over line breaks are checked apart from the timing with every split
+std::vector<double> lexParallel(size_t size) {
+    std::string text = mixed(size);
+    auto start = Clock::now();
+    TokenParser sequential;
+    sequential.setParallelThreshold(0);
+    const std::vector<LexToken> &expected = sequential.lex(text);
+    double one = millisSince(start);
+
+    start = Clock::now();
+    TokenParser parallel;
+    parallel.setParallelThreshold(1);
+    parallel.setThreads(std::max(std::thread::hardware_concurrency(), 2u));
+    const std::vector<LexToken> &tokens = parallel.lex(text);
+    double all = millisSince(start);
+    if (!sameTokens(expected, tokens)) throw std::logic_error("lexing in parallel gave different tokens");
+
+    const std::string strings = multilineStrings(std::max<size_t>(size / 16, 1));
+    const std::vector<LexToken> stringTokens = sequential.lex(strings);
+    for (unsigned threads = 2; threads <= 9; ++threads) {
+        parallel.setThreads(threads);
+        if (!sameTokens(stringTokens, parallel.lex(strings)))
+            throw std::logic_error("lexing in parallel gave different tokens across strings split between pieces");
+    }
+    return {one, all};
+}
+
+// The mixed statements built into a tree in one go against split between the cores, at least two even on one core
+std::vector<double> treeParallel(size_t size) {
+    std::string text = mixed(size);
+    TokenParser parser;
+    const std::vector<LexToken> &tokens = parser.lex(text);
+
+    auto start = Clock::now();
+    IntermediateNode sequential;
+    sequential.setParallelThreshold(0);
+    sequential.generateTree(text, tokens);
+    double one = millisSince(start);
+
+    start = Clock::now();
+    IntermediateNode parallel;
+    parallel.setParallelThreshold(1);
+    parallel.setThreads(std::max(std::thread::hardware_concurrency(), 2u));
+    parallel.generateTree(text, tokens);
+    double all = millisSince(start);
+    if (!sequential.isSameTree(&parallel)) throw std::logic_error("the parallel build made a different tree");
+    return {one, all};
+}
+
+// Lexing every token before building against pulling them from the lexer as the tree is built, both from the text
+std::vector<double> treeStream(size_t size) {
+    std::string text = mixed(size);
+    auto start = Clock::now();
+    TokenParser parser;
+    parser.setParallelThreshold(0);
+    IntermediateNode whole;
+    whole.setParallelThreshold(0);
+    whole.generateTree(text, parser.lex(text));
+    double vector = millisSince(start);
+
+    start = Clock::now();
+    IntermediateNode streamed;
+    streamed.generateTree(text);
+    double stream = millisSince(start);
+    if (!whole.isSameTree(&streamed)) throw std::logic_error("the streamed build made a different tree");
+    return {vector, stream};
+}
+
+// The same two passes over the tree linked and laid out flat, a walk reading every token and the error check
+std::vector<double> flatTree(size_t size) {
+    std::string text = mixed(size);
+    TokenParser parser;
+    IntermediateNode root;
+    root.generateTree(text, parser.lex(text));
+
+    auto start = Clock::now();
+    FlatTree flat(&root);
+    double flatten = millisSince(start);
+
+    start = Clock::now();
+    IntermediateNode *top = &root;
+    while (top->getParent() != nullptr) top = top->getParent();
+    uint64_t linkedSum = 0;
+    size_t statement = 0;
+    uint32_t base = 0;
+    for (IntermediateNode *node = top; node != nullptr; node = node->getNextInPreOrder(nullptr)) {
+        if (node->getParent() == nullptr) base = root.getStatementOffset(statement++);
+        linkedSum += base + node->getToken().getOffset() + (uint64_t)node->getToken().getType();
+    }
+    double linkedWalk = millisSince(start);
+
+    start = Clock::now();
+    uint64_t flatSum = 0;
+    for (FlatTree::Index node = 0; node < flat.size(); ++node)
+        flatSum += flat.getOffset(node) + (uint64_t)flat.getType(node);
+    double flatWalk = millisSince(start);
+
+    start = Clock::now();
+    std::vector<SyntaxError> linkedErrors = root.getErrors();
+    double linkedCheck = millisSince(start);
+
+    start = Clock::now();
+    std::vector<SyntaxError> flatErrors = flat.getErrors();
+    double flatCheck = millisSince(start);
+
+    bool same = linkedSum == flatSum && linkedErrors.size() == flatErrors.size();
+    for (size_t i = 0; same && i < linkedErrors.size(); ++i)
+        same = linkedErrors[i].getOffset() == flatErrors[i].getOffset() && linkedErrors[i].getType() == flatErrors[i].getType();
+    if (!same) throw std::logic_error("the flat tree does not match the linked one");
+    return {flatten, linkedWalk, flatWalk, linkedCheck, flatCheck};
+}
+
+// Classifies every word of the mixed statements, as the tree builder does once per token
+std::vector<double> classify(size_t size) {
+    std::string text = mixed(size);
+    TokenParser parser;
+    const std::vector<LexToken> &tokens = parser.lex(text);
+
+    auto start = Clock::now();
+    size_t names = 0;
+    for (const LexToken &token : tokens)
+        if (token.kind == LexToken::Kind::WORD)
+            names += Token::getLiteral(token.text(text), false) == Token::TokenType::NAME;
+    volatile size_t total = names;
+    (void)total;
+    return {millisSince(start)};
+}
+
+// Finds where every line of the mixed statements starts, done once for a file when its errors are shown
+std::vector<double> lineIndex(size_t size) {
+    std::string text = mixed(size);
+    auto start = Clock::now();
+    SourceLines lines(text);
+    volatile size_t count = lines.getLineCount();
+    (void)count;
+    return {millisSince(start)};
+}
+
+// Makes the edit and throws unless the lexer's tokens are what lexing its whole text again gives, and the range it
+        // says changed accounts for the difference in the number of tokens
+void checkRelex(IncrementalLexer &lexer, size_t first, size_t removed, std::vector<std::string> lines, const char *edit) {
+    const size_t before = lexer.getTokens().size();
+    IncrementalLexer::LineRange range = lexer.update(first, removed, std::move(lines));
+    std::string text = lexer.getText();
+    TokenParser parser;
+    parser.setParallelThreshold(0);
+    const std::vector<LexToken> &expected = parser.lex(text);
+    const std::vector<LexToken> tokens = lexer.getTokens();
+    auto same = [](const LexToken &a, const LexToken &b) { return a.offset == b.offset && a.length == b.length && a.kind == b.kind; };
+    if (!std::equal(tokens.begin(), tokens.end(), expected.begin(), expected.end(), same)
+            || before - range.removedTokens + range.addedTokens != tokens.size())
+        throw std::logic_error(std::string("re-lexing after ") + edit + " gave different tokens than lexing it all");
+}
+
+// A keystroke in the middle of a size line document, against lexing the whole document again
+std::vector<double> lineEdit(size_t size) {
+    std::vector<std::string> lines = documentLines(size);
+    IncrementalLexer lexer;
+    lexer.reset(lines);
+    std::string text = lexer.getText();
+
+    auto start = Clock::now();
+    TokenParser parser;
+    parser.lex(text);
+    double full = millisSince(start);
+
+    std::string edited = lines[size / 2];
+    edited.insert(edited.begin() + 7, 'x');
+    start = Clock::now();
+    lexer.update(size / 2, 1, {edited});
+    double relex = millisSince(start);
+
+    // The keystroke undone, then edits that start and end strings or only take lines away
+    checkRelex(lexer, size / 2, 1, {lines[size / 2]}, "a keystroke");
+    checkRelex(lexer, size / 2, 1, {"x = \"open\n"}, "opening a string");
+    checkRelex(lexer, size / 2, 1, {}, "deleting the line that opened it");
+    checkRelex(lexer, size / 2, 0, {"x = \"a \\\" b\\\\\"\n"}, "a string with escapes");
+    checkRelex(lexer, size / 2, 1, {"x = \"a \\\\\" b\"\n"}, "escaping the backslash instead");
+    checkRelex(lexer, 0, 0, {"\" \n"}, "opening a string at the start");
+    checkRelex(lexer, 0, 1, {}, "deleting the first line");
+    checkRelex(lexer, lexer.getLineCount() - 1, 1, {}, "deleting the last line");
+    IncrementalLexer small;
+    small.reset({"\" \n", "x "});
+    checkRelex(small, 0, 1, {}, "deleting the line a string started on");
+    return {full, relex};
+}
+
+// The same keystroke, rebuilding the tree from the statement it is in against building it all again. The update reads its tokens
+        // straight from the lexer and takes in the errors, the same as the editor does
+std::vector<double> treeEdit(size_t size) {
+    std::vector<std::string> lines = documentLines(size);
+    IncrementalLexer lexer;
+    lexer.reset(lines);
+    IntermediateNode root;
+    root.generateTree(lexer.getText(), lexer.getTokens());
+
+    std::string edited = lines[size / 2];
+    edited.insert(edited.begin() + 7, 'x');
+    IncrementalLexer::LineRange range = lexer.update(size / 2, 1, {edited});
+    std::string text = lexer.getText();
+    std::vector<LexToken> tokens = lexer.getTokens();
+
+    auto start = Clock::now();
+    IntermediateNode full;
+    full.generateTree(text, tokens);
+    std::vector<SyntaxError> fullErrors = full.getErrors();
+    double rebuild = millisSince(start);
+
+    start = Clock::now();
+    std::string scratch[2];
+    auto lookup = [&](size_t index) {
+        const LexToken token = lexer.getToken(index);
+        return IntermediateNode::TokenText{lexer.getTokenText(token, scratch[index % 2]), token.offset};
+    };
+    if (!root.updateTree(lexer.getTokenCount(), lookup, {(uint32_t)range.firstToken, (uint32_t)range.removedTokens,
+            (uint32_t)range.addedTokens, 1}))
+        throw std::logic_error("the edit needed the whole tree built again");
+    std::vector<SyntaxError> errors = root.getErrors();
+    double update = millisSince(start);
+    if (!root.isSameTree(&full) || errors.size() != fullErrors.size()) throw std::logic_error("the updated tree does not match a full build");
+    return {rebuild, update};
+}
+
+const std::vector<Benchmark>& benchmarks() {
+    static const std::vector<Benchmark> list = {
+        {"list-literal", "one list literal with <size> elements", 100000, frontEndColumns, 1, frontEnd(listLiteral)},
+        {"statements", "<size> top level const statements", 1000000, frontEndColumns, 1, frontEnd(statements)},
+        {"nesting", "list literals nested <size> deep", 20000, frontEndColumns, 1, frontEnd(nesting)},
+        {"expression", "one expression of <size> operators at every level of precedence", 100000, frontEndColumns, 1, frontEnd(expression)},
+        {"mixed", "<size> of each kind of statement", 100000, frontEndColumns, 1, frontEnd(mixed)},
+        {"signs", "<size> signs in a row with nothing to sign, then the next statement", 100000, frontEndColumns, 1, frontEnd(signs)},
+        {"stray", "an expression of <size> operators then <size> closing brackets nothing opened", 100000, frontEndColumns, 1,
+                frontEnd(strayBrackets)},
+        {"unclosed", "<size> '(' closed with ']'", 20000, frontEndColumns, 1, frontEnd(unclosed)},
+        {"half-typed", "<size> of each kind of statement, every line cut off partway", 100000, frontEndColumns, 1, frontEnd(halfTyped)},
+        {"lex-generated", "<size> blocks of machine written source lexed with each instruction set", 100000, lexColumns, 2, lexLevels(generated)},
+        {"lex-mixed", "<size> of each kind of statement lexed with each instruction set", 100000, lexColumns, 2, lexLevels(mixed)},
+        {"lex-parallel", "<size> of each kind of statement lexed in one go and on every core", 200000,
+                {"sequential ms", "parallel ms"}, 1, lexParallel},
+        {"tree-parallel", "the tree of <size> of each kind of statement built in one go and on every core", 100000,
+                {"sequential ms", "parallel ms"}, 1, treeParallel},
+        {"stream", "the tree of <size> of each kind of statement from lexed tokens and straight from the lexer", 100000,
+                {"vector ms", "stream ms"}, 1, treeStream},
+        {"flat", "a walk and the error check over the tree of <size> of each kind of statement, linked and flat", 100000,
+                {"flatten ms", "walk ms", "flat walk ms", "check ms", "flat check ms"}, 2, flatTree},
+        {"classify", "every word of <size> of each kind of statement given its literal type", 100000, {"classify ms"}, 0, classify},
+        {"lines", "the line starts of <size> of each kind of statement", 100000, {"index ms"}, 0, lineIndex},
+        {"relex", "one character typed into a <size> line document", 50000, {"full lex ms", "relex ms"}, 1, lineEdit},
+        {"reparse", "the tree after one character typed into a <size> line document", 50000, {"full tree ms", "update ms"}, 1, treeEdit},
+    };
+    return list;
+}
+
+}
+
+void listBenchmarks(std::ostream& os) {
+    for (const Benchmark& benchmark : benchmarks())
+        os << "  " << std::left << std::setw(16) << benchmark.name << benchmark.description
+           << " (default " << benchmark.defaultSize << ")\n" << std::right;
+}
+
+int runBenchmark(const std::string& name, size_t size, std::ostream& os) {
+    auto it = std::find_if(benchmarks().begin(), benchmarks().end(),
+            [&](const Benchmark& benchmark) { return name == benchmark.name; });
+    if (it == benchmarks().end()) {
+        os << "wbsc: unknown benchmark " << name << ", choose from:\n";
+        listBenchmarks(os);
+        return 2;
+    }
+    if (size == 0) size = it->defaultSize;
+
+    os << it->name << ": " << it->description << "\n" << std::setw(10) << "size";
+    for (const char *column : it->columns) os << std::setw(14) << column;
+    os << std::setw(14) << "ns/element" << std::setw(10) << "growth" << "\n";
+    // Each step doubles the size, so linear scaling shows up as a growth of about 2
+    double previous = 0;
+    for (size_t step = std::max<size_t>(size / 8, 1); step <= size; step *= 2) {
+        std::vector<double> best;
+        // Best of three to keep noise from other processes out
+        for (int run = 0; run < 3; ++run) {
+            std::vector<double> times;
+            try {
+                times = it->run(step);
+            } catch (const std::exception &e) {
+                os << "\nwbsc: " << e.what() << "\n";
+                return 1;
+            }
+            if (best.empty() || times[it->growthColumn] < best[it->growthColumn]) best = times;
+        }
+        double total = 0;
+        os << std::fixed << std::setprecision(3) << std::setw(10) << step;
+        for (double time : best) {
+            os << std::setw(14) << time;
+            total += time;
+        }
+        os << std::setw(14) << total * 1e6 / step << std::setw(10) << std::setprecision(2);
+        if (previous > 0) os << best[it->growthColumn] / previous;
+        else os << "-";
+        os << "\n";
+        previous = best[it->growthColumn];
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+/* benchmarks.h
+PURPOSE:
+- Synthetic inputs for timing the compiler front end from wbsc, real projects are too small to show how it scales
+*/
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+void listBenchmarks(std::ostream& os);
+// Runs the benchmark at doubling sizes up to size (0 for its default), returns the exit status for wbsc
+int runBenchmark(const std::string& name, size_t size, std::ostream& os);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,186 @@
+/* bytescan.cpp
+PURPOSE:
+- Finds where runs of bytes the lexer would otherwise step through one at a time end, 16 or 32 bytes at a time
+*/
+#include "bytescan.h"
+#include <atomic>
+
+// The vector versions are built for their own instruction set whatever the rest of the build targets,
+        // which needs the target attribute, so other compilers only get the scalar ones
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BYTESCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Every level has the same three, with the text as a pointer and size so they need nothing from the header
+struct Scanners {
+    size_t (*word)(const char *text, size_t from, size_t size);
+    size_t (*blank)(const char *text, size_t from, size_t size);
+    size_t (*until)(const char *text, size_t from, size_t size, char a);
+};
+
+size_t wordScalar(const char *text, size_t from, size_t size) {
+    while (from < size && ByteScan::isWord(text[from])) ++from;
+    return from;
+}
+
+size_t blankScalar(const char *text, size_t from, size_t size) {
+    while (from < size && (ByteScan::classes[(uint8_t)text[from]] & ByteScan::BLANK)) ++from;
+    return from;
+}
+
+size_t untilScalar(const char *text, size_t from, size_t size, char a) {
+    while (from < size && text[from] != a && text[from] != '\n') ++from;
+    return from;
+}
+
+constexpr Scanners scalar = {wordScalar, blankScalar, untilScalar};
+
+#ifdef BYTESCAN_X86
+// Bytes are compared as signed, so anything from 0x80 up is below every ASCII bound and never counts as in a range
+
+__attribute__((target("sse2")))
+inline __m128i inRange16(__m128i v, char low, char high) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(low - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(high + 1)));
+}
+
+__attribute__((target("sse2")))
+size_t wordSse2(const char *text, size_t from, size_t size) {
+    for (; from + 16 <= size; from += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(text + from));
+        // Setting 0x20 makes capitals lower case and nothing else a letter
+        const __m128i word = _mm_or_si128(
+                _mm_or_si128(inRange16(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'), inRange16(v, '0', '9')),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), _mm_cmpeq_epi8(v, _mm_set1_epi8('.'))));
+        const uint32_t mask = ~(uint32_t)_mm_movemask_epi8(word) & 0xFFFF;
+        if (mask != 0) return from + __builtin_ctz(mask);
+    }
+    return wordScalar(text, from, size);
+}
+
+__attribute__((target("sse2")))
+size_t blankSse2(const char *text, size_t from, size_t size) {
+    for (; from + 16 <= size; from += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(text + from));
+        // '\t' to '\r' and ' ', apart from the '\n' in the middle
+        const __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), inRange16(v, '\t', '\r')));
+        const uint32_t mask = ~(uint32_t)_mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask != 0) return from + __builtin_ctz(mask);
+    }
+    return blankScalar(text, from, size);
+}
+
+__attribute__((target("sse2")))
+size_t untilSse2(const char *text, size_t from, size_t size, char a) {
+    const __m128i stop = _mm_set1_epi8(a), newline = _mm_set1_epi8('\n');
+    for (; from + 16 <= size; from += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(text + from));
+        const uint32_t mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, stop), _mm_cmpeq_epi8(v, newline)));
+        if (mask != 0) return from + __builtin_ctz(mask);
+    }
+    return untilScalar(text, from, size, a);
+}
+
+constexpr Scanners sse2 = {wordSse2, blankSse2, untilSse2};
+
+__attribute__((target("avx2")))
+inline __m256i inRange32(__m256i v, char low, char high) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(low - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), v));
+}
+
+__attribute__((target("avx2")))
+size_t wordAvx2(const char *text, size_t from, size_t size) {
+    for (; from + 32 <= size; from += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(text + from));
+        const __m256i word = _mm256_or_si256(
+                _mm256_or_si256(inRange32(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'), inRange32(v, '0', '9')),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'))));
+        const uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(word);
+        if (mask != 0) return from + __builtin_ctz(mask);
+    }
+    return wordSse2(text, from, size);
+}
+
+__attribute__((target("avx2")))
+size_t blankAvx2(const char *text, size_t from, size_t size) {
+    for (; from + 32 <= size; from += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(text + from));
+        const __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), inRange32(v, '\t', '\r')));
+        const uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(blank);
+        if (mask != 0) return from + __builtin_ctz(mask);
+    }
+    return blankSse2(text, from, size);
+}
+
+__attribute__((target("avx2")))
+size_t untilAvx2(const char *text, size_t from, size_t size, char a) {
+    const __m256i stop = _mm256_set1_epi8(a), newline = _mm256_set1_epi8('\n');
+    for (; from + 32 <= size; from += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(text + from));
+        const uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, stop), _mm256_cmpeq_epi8(v, newline)));
+        if (mask != 0) return from + __builtin_ctz(mask);
+    }
+    return untilSse2(text, from, size, a);
+}
+
+constexpr Scanners avx2 = {wordAvx2, blankAvx2, untilAvx2};
+#endif
+
+ByteScan::Level detect() {
+    #ifdef BYTESCAN_X86
+    // Needed when this runs before main, as it does when it sets up active
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return ByteScan::Level::AVX2;
+    if (__builtin_cpu_supports("sse2")) return ByteScan::Level::SSE2;
+    #endif
+    return ByteScan::Level::SCALAR;
+}
+
+const Scanners * scannersFor(ByteScan::Level level) {
+    switch (level) {
+        #ifdef BYTESCAN_X86
+        case ByteScan::Level::AVX2:
+            return &avx2;
+        case ByteScan::Level::SSE2:
+            return &sse2;
+        #endif
+        default:
+            return &scalar;
+    }
+}
+
+const ByteScan::Level best = detect();
+std::atomic<ByteScan::Level> level = best;
+std::atomic<const Scanners *> active = scannersFor(best);
+
+}
+
+ByteScan::Level ByteScan::getBest() {
+    return best;
+}
+
+ByteScan::Level ByteScan::getLevel() {
+    return level;
+}
+
+void ByteScan::setLevel(Level wanted) {
+    if (wanted > best) wanted = best;
+    level = wanted;
+    active = scannersFor(wanted);
+}
+
+size_t ByteScan::scanWord(std::string_view text, size_t from) {
+    return active.load(std::memory_order_relaxed)->word(text.data(), from, text.size());
+}
+
+size_t ByteScan::scanBlank(std::string_view text, size_t from) {
+    return active.load(std::memory_order_relaxed)->blank(text.data(), from, text.size());
+}
+
+size_t ByteScan::scanUntil(std::string_view text, size_t from, char a) {
+    return active.load(std::memory_order_relaxed)->until(text.data(), from, text.size(), a);
+}
@@ -0,0 +1,90 @@
+/* bytescan.h
+PURPOSE:
+- Finds where runs of bytes the lexer would otherwise step through one at a time end, 16 or 32 bytes at a time
+- None of the runs ever take in a '\n', so SourceLines finds line breaks with the same scan comments end on
+*/
+#ifndef BYTESCAN_H
+#define BYTESCAN_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ByteScan {
+    // Picked on first use from what the processor supports, anything without SSE2 or not built with GCC or Clang gets SCALAR
+    enum class Level : uint8_t {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+    Level getBest();
+    Level getLevel();
+    // For comparing them, a level the processor cannot run is lowered to the best one it can
+    void setLevel(Level level);
+
+    // The same as the skip functions below but straight to the vector scan, for runs known to be long
+    size_t scanWord(std::string_view text, size_t from);
+    size_t scanBlank(std::string_view text, size_t from);
+    size_t scanUntil(std::string_view text, size_t from, char a);
+
+    // What each byte is, so the lexer's own checks match the vector ones exactly
+    enum ByteClass : uint8_t {
+        WORD = 1,
+        BLANK = 2,
+        SPACE = 4 // Blank or '\n'
+    };
+    constexpr std::array<uint8_t, 256> buildClasses() {
+        std::array<uint8_t, 256> classes{};
+        for (int c = '0'; c <= '9'; ++c) classes[c] = WORD;
+        for (int c = 'a'; c <= 'z'; ++c) classes[c] = WORD;
+        for (int c = 'A'; c <= 'Z'; ++c) classes[c] = WORD;
+        classes['_'] = WORD;
+        classes['.'] = WORD;
+        for (char c : {' ', '\t', '\r', '\v', '\f'}) classes[(uint8_t)c] = BLANK | SPACE;
+        classes['\n'] = SPACE;
+        return classes;
+    }
+    inline constexpr std::array<uint8_t, 256> classes = buildClasses();
+
+    inline bool isWord(char c) {
+        return classes[(uint8_t)c] & WORD;
+    }
+    inline bool isSpace(char c) {
+        return classes[(uint8_t)c] & SPACE;
+    }
+
+    // Most runs in real code are a few bytes, so that many are checked in line before going to the vector scan
+    constexpr size_t shortRun = 8;
+
+    // Each gives the index of the first byte at or after from that ends the run, or text.size()
+    // Word characters: letters, digits, '_' and '.'
+    inline size_t skipWord(std::string_view text, size_t from) {
+        for (const size_t end = std::min(from + shortRun, text.size()); from < end; ++from)
+            if (!isWord(text[from])) return from;
+        return from < text.size() ? scanWord(text, from) : from;
+    }
+    // Whitespace that is not a '\n'
+    inline size_t skipBlank(std::string_view text, size_t from) {
+        for (const size_t end = std::min(from + shortRun, text.size()); from < end; ++from)
+            if (!(classes[(uint8_t)text[from]] & BLANK)) return from;
+        return from < text.size() ? scanBlank(text, from) : from;
+    }
+    // Anything that is not a or '\n', for comments and strings
+    inline size_t skipUntil(std::string_view text, size_t from, char a) {
+        for (const size_t end = std::min(from + shortRun, text.size()); from < end; ++from)
+            if (text[from] == a || text[from] == '\n') return from;
+        return from < text.size() ? scanUntil(text, from, a) : from;
+    }
+
+    // Whether the byte at i is escaped, by an odd run of backslashes before it. Only looks back within text, which is
+            // enough as long as it starts at a line break or the opening quote, runs of them never reach past either
+    inline bool isEscaped(std::string_view text, size_t i) {
+        size_t slashes = 0;
+        while (slashes < i && text[i - slashes - 1] == '\\') ++slashes;
+        return slashes % 2 == 1;
+    }
+}
+
+#endif // BYTESCAN_H
@@ -0,0 +1,253 @@
+/* chunkedlist.hpp
+PURPOSE:
+- A list kept in chunks of a few hundred elements, so adding or removing in the middle only moves the elements of one chunk
+- Each element has a few counts (like how many tokens or bytes it holds), the total of them over every element before one
+        is found from a Fenwick tree over the chunks, so an edit never has to shift along what comes after it
+*/
+#ifndef CHUNKEDLIST_HPP
+#define CHUNKEDLIST_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+template <typename T, size_t Counts>
+class ChunkedList {
+public:
+    // The counts of one element, or their totals over a run of them
+    using Sizes = std::array<uint64_t, Counts>;
+
+    size_t size() const {
+        return length;
+    }
+    bool empty() const {
+        return length == 0;
+    }
+
+    // Both find the chunk through the tree, so going through every element this way is n log n
+    const T& operator[](size_t index) const {
+        Where at = locate(index);
+        return chunks[at.chunk].items[at.item];
+    }
+    // Changing what an element holds does not change its counts, that is up to setCounts()
+    T& operator[](size_t index) {
+        Where at = locate(index);
+        return chunks[at.chunk].items[at.item];
+    }
+
+    uint64_t getCount(size_t index, size_t which) const {
+        Where at = locate(index);
+        const Chunk &chunk = chunks[at.chunk];
+        return chunk.ends[at.item][which] - (at.item > 0 ? chunk.ends[at.item - 1][which] : 0);
+    }
+    // Total of a count over every element before index, size() gives the total of the whole list
+    uint64_t getBefore(size_t index, size_t which) const {
+        if (index == length) return getTotal(which);
+        Where at = locate(index);
+        return treeBefore(at.chunk)[which] + (at.item > 0 ? chunks[at.chunk].ends[at.item - 1][which] : 0);
+    }
+    uint64_t getTotal(size_t which) const {
+        return chunks.empty() ? 0 : treeBefore(chunks.size())[which];
+    }
+    // The element a running total of position lands in, which is the last one with getBefore() at or under it that has a count
+            // at all, position has to be less than getTotal()
+    size_t find(uint64_t position, size_t which) const {
+        auto [chunk, rest] = treeFind(position, which);
+        const std::vector<Sizes> &ends = chunks[chunk].ends;
+        const size_t item = std::upper_bound(ends.begin(), ends.end(), rest,
+                [which](uint64_t value, const Sizes &end) { return value < end[which]; }) - ends.begin();
+        return (size_t)treeBefore(chunk)[Counts] + item;
+    }
+
+    void setCounts(size_t index, const Sizes &counts) {
+        Where at = locate(index);
+        Chunk &chunk = chunks[at.chunk];
+        Totals change{};
+        for (size_t which = 0; which < Counts; ++which)
+            change[which] = counts[which] - (chunk.ends[at.item][which] - (at.item > 0 ? chunk.ends[at.item - 1][which] : 0));
+        for (size_t item = at.item; item < chunk.ends.size(); ++item)
+            for (size_t which = 0; which < Counts; ++which) chunk.ends[item][which] += change[which];
+        treeAdd(at.chunk, change);
+    }
+
+    // Puts the items in before index, counts has the counts of each of them
+    void insert(size_t index, std::vector<T> items, const std::vector<Sizes> &counts) {
+        if (items.empty()) return;
+        if (chunks.empty()) chunks.emplace_back();
+        // Past the end goes on the end of the last chunk
+        Where at = index >= length ? Where{chunks.size() - 1, chunks.back().items.size()} : locate(index);
+        Chunk &chunk = chunks[at.chunk];
+        toCounts(chunk, at.item);
+        chunk.items.insert(chunk.items.begin() + at.item, std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+        chunk.ends.insert(chunk.ends.begin() + at.item, counts.begin(), counts.end());
+        length += items.size();
+        update(at.chunk, at.item);
+    }
+
+    void erase(size_t index, size_t count) {
+        count = std::min(count, length - std::min(index, length));
+        if (count == 0) return;
+        const Where from = locate(index);
+        const Where to = index + count == length ? Where{chunks.size() - 1, chunks.back().items.size()} : locate(index + count);
+        length -= count;
+        Chunk &first = chunks[from.chunk];
+        if (from.chunk == to.chunk) {
+            toCounts(first, from.item);
+            first.items.erase(first.items.begin() + from.item, first.items.begin() + to.item);
+            first.ends.erase(first.ends.begin() + from.item, first.ends.begin() + to.item);
+            update(from.chunk, from.item);
+            return;
+        }
+        // Spread over more than one chunk, the ones in between go whole and only the two ends are left to settle
+        Chunk &last = chunks[to.chunk];
+        toCounts(last, 0);
+        last.items.erase(last.items.begin(), last.items.begin() + to.item);
+        last.ends.erase(last.ends.begin(), last.ends.begin() + to.item);
+        toEnds(last, 0);
+        first.items.erase(first.items.begin() + from.item, first.items.end());
+        first.ends.erase(first.ends.begin() + from.item, first.ends.end());
+        chunks.erase(chunks.begin() + from.chunk + 1, chunks.begin() + to.chunk);
+        // Both ends already add up, settling them from past their last item only splits or merges them
+        settle(from.chunk + 1, chunks[from.chunk + 1].items.size());
+        settle(from.chunk, chunks[from.chunk].items.size());
+        rebuildTree();
+    }
+
+    void clear() {
+        chunks.clear();
+        tree.clear();
+        length = 0;
+    }
+
+private:
+    // Past maxChunk a chunk is split into ones half that size, under minChunk it is merged into a neighbour it fits with
+    static constexpr size_t maxChunk = 512, minChunk = 64;
+
+    // The counts, then the number of elements
+    using Totals = std::array<uint64_t, Counts + 1>;
+
+    struct Chunk {
+        std::vector<T> items;
+        std::vector<Sizes> ends; // Running totals of the counts within the chunk, each takes in its own item
+    };
+    struct Where {
+        size_t chunk, item;
+    };
+
+    std::vector<Chunk> chunks;
+    std::vector<Totals> tree; // Fenwick tree over the chunks' totals, 1 based
+    size_t length = 0;
+
+    static Totals totalsOf(const Chunk &chunk) {
+        Totals totals{};
+        if (!chunk.ends.empty()) std::copy(chunk.ends.back().begin(), chunk.ends.back().end(), totals.begin());
+        totals[Counts] = chunk.items.size();
+        return totals;
+    }
+    // Turns the running totals from item on back into each item's own counts, for putting items in or taking them out there
+    static void toCounts(Chunk &chunk, size_t item) {
+        for (size_t i = chunk.ends.size(); i-- > std::max<size_t>(item, 1); )
+            for (size_t which = 0; which < Counts; ++which) chunk.ends[i][which] -= chunk.ends[i - 1][which];
+    }
+    // And the other way once they are in
+    static void toEnds(Chunk &chunk, size_t item) {
+        for (size_t i = std::max<size_t>(item, 1); i < chunk.ends.size(); ++i)
+            for (size_t which = 0; which < Counts; ++which) chunk.ends[i][which] += chunk.ends[i - 1][which];
+    }
+
+    Totals treeBefore(size_t chunk) const {
+        Totals sum{};
+        for (size_t i = chunk; i > 0; i -= i & -i)
+            for (size_t which = 0; which <= Counts; ++which) sum[which] += tree[i][which];
+        return sum;
+    }
+    void treeAdd(size_t chunk, const Totals &change) {
+        for (size_t i = chunk + 1; i < tree.size(); i += i & -i)
+            for (size_t which = 0; which <= Counts; ++which) tree[i][which] += change[which];
+    }
+    // The chunk a running total lands in and what is left of it past the chunks before
+    std::pair<size_t, uint64_t> treeFind(uint64_t position, size_t which) const {
+        size_t chunk = 0;
+        for (size_t step = std::bit_floor(chunks.size()); step > 0; step >>= 1)
+            if (chunk + step < tree.size() && tree[chunk + step][which] <= position) {
+                chunk += step;
+                position -= tree[chunk][which];
+            }
+        return {std::min(chunk, chunks.size() - 1), position};
+    }
+    void rebuildTree() {
+        tree.assign(chunks.size() + 1, Totals{});
+        for (size_t i = 1; i < tree.size(); ++i) {
+            const Totals totals = totalsOf(chunks[i - 1]);
+            for (size_t which = 0; which <= Counts; ++which) tree[i][which] += totals[which];
+            const size_t parent = i + (i & -i);
+            if (parent < tree.size())
+                for (size_t which = 0; which <= Counts; ++which) tree[parent][which] += tree[i][which];
+        }
+    }
+
+    Where locate(size_t index) const {
+        auto [chunk, item] = treeFind(index, Counts);
+        return {chunk, (size_t)item};
+    }
+
+    // Settles a chunk that changed from item on and brings the tree up to date, the tree still has its old totals
+    void update(size_t index, size_t item) {
+        Totals change{};
+        if (index + 1 < tree.size()) {
+            const Totals after = treeBefore(index + 1), before = treeBefore(index);
+            for (size_t which = 0; which <= Counts; ++which) change[which] = before[which] - after[which];
+        }
+        if (settle(index, item) || tree.size() != chunks.size() + 1) return rebuildTree();
+        const Totals totals = totalsOf(chunks[index]);
+        for (size_t which = 0; which <= Counts; ++which) change[which] += totals[which];
+        treeAdd(index, change);
+    }
+
+    // Adds the running totals back up from item on, then splits or merges the chunk if it has grown or shrunk too far,
+            // gives whether the chunks changed so the tree has to be built again
+    bool settle(size_t index, size_t item) {
+        if (index >= chunks.size()) return false;
+        Chunk &chunk = chunks[index];
+        toEnds(chunk, item);
+        if (chunk.items.size() > maxChunk) {
+            // Half the largest size leaves each piece room to grow before it splits again
+            constexpr size_t half = maxChunk / 2;
+            std::vector<Chunk> pieces;
+            for (size_t from = 0; from < chunk.items.size(); from += half) {
+                const size_t to = std::min(from + half, chunk.items.size());
+                Chunk piece;
+                piece.items.assign(std::make_move_iterator(chunk.items.begin() + from), std::make_move_iterator(chunk.items.begin() + to));
+                piece.ends.assign(chunk.ends.begin() + from, chunk.ends.begin() + to);
+                if (from > 0)
+                    for (Sizes &end : piece.ends)
+                        for (size_t which = 0; which < Counts; ++which) end[which] -= chunk.ends[from - 1][which];
+                pieces.push_back(std::move(piece));
+            }
+            chunks.erase(chunks.begin() + index);
+            chunks.insert(chunks.begin() + index, std::make_move_iterator(pieces.begin()), std::make_move_iterator(pieces.end()));
+            return true;
+        }
+        if (chunk.items.empty()) {
+            chunks.erase(chunks.begin() + index);
+            return true;
+        }
+        if (chunk.items.size() >= minChunk || chunks.size() == 1) return false;
+        const size_t low = index + 1 < chunks.size() ? index : index - 1;
+        Chunk &a = chunks[low], &b = chunks[low + 1];
+        if (a.items.size() + b.items.size() > maxChunk) return false;
+        const size_t joined = a.items.size();
+        toCounts(b, 0);
+        a.items.insert(a.items.end(), std::make_move_iterator(b.items.begin()), std::make_move_iterator(b.items.end()));
+        a.ends.insert(a.ends.end(), b.ends.begin(), b.ends.end());
+        toEnds(a, joined);
+        chunks.erase(chunks.begin() + low + 1);
+        return true;
+    }
+};
+
+#endif // CHUNKEDLIST_HPP
@@ -0,0 +1,254 @@
+/* compilermain.cpp
+PURPOSE:
+- Launches the headless command line compiler (wbsc), for batch builds and profiling without the GUI
+*/
+#include "defines.h"
+#include "tokenparser.h"
+#include "intermediatenode.h"
+#include "sourcelines.h"
+#include "benchmarks.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::vector<fs::path> inputs;
+    fs::path output;
+    std::string benchmark;
+    size_t benchmarkSize = 0;
+    bool quiet = false;
+    bool generate = true;
+};
+
+// Time spent in each phase of the pipeline, in milliseconds
+struct PhaseTimes {
+    double read = 0, lex = 0, tree = 0, check = 0;
+    size_t bytes = 0, tokens = 0, nodes = 0, errors = 0;
+    size_t files = 0, streamed = 0; // Files compiled and how many of them were lexed as their tree was built, counted in tree
+
+    PhaseTimes& operator+=(const PhaseTimes& other) {
+        read += other.read;
+        lex += other.lex;
+        tree += other.tree;
+        check += other.check;
+        bytes += other.bytes;
+        tokens += other.tokens;
+        nodes += other.nodes;
+        errors += other.errors;
+        files += other.files;
+        streamed += other.streamed;
+        return *this;
+    }
+};
+
+double millisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void printUsage(std::ostream& os) {
+    os << "Usage: wbsc [options] <project directory | file...>\n"
+          "       wbsc --bench <name> [--size <n>]\n"
+          "Options:\n"
+          "  -o <file>      Write the generated site to <file> (default: website.php in the project directory)\n"
+          "  --no-generate  Only lex, build the tree and check it, do not write any output\n"
+          "  -q             Do not print the timing report, in it a file lexed as its tree is built shows - for lex ms\n"
+          "                 and its lexing is counted in tree ms, that is every file under 256KB or all of them on one core\n"
+          "  -h, --help     Show this message\n"
+          "Exits with 1 if a file cannot be read or has syntax errors, nothing is generated then\n"
+          "Benchmarks:\n";
+    listBenchmarks(os);
+}
+
+// Returns 0 to carry on, otherwise the exit status to stop with
+int parseArguments(int argc, char *argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(std::cout);
+            return -1;
+        } else if (arg == "-o") {
+            if (++i >= argc) {
+                std::cerr << "wbsc: -o needs a file name\n";
+                return 2;
+            }
+            options.output = argv[i];
+        } else if (arg == "--bench" || arg == "--size") {
+            if (++i >= argc) {
+                std::cerr << "wbsc: " << arg << " needs a value\n";
+                return 2;
+            }
+            if (arg == "--bench") options.benchmark = argv[i];
+            else options.benchmarkSize = std::strtoull(argv[i], nullptr, 10);
+        } else if (arg == "--no-generate") options.generate = false;
+        else if (arg == "-q") options.quiet = true;
+        else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "wbsc: unknown option " << arg << "\n";
+            printUsage(std::cerr);
+            return 2;
+        } else options.inputs.push_back(arg);
+    }
+    if (options.inputs.empty() && options.benchmark.empty()) {
+        printUsage(std::cerr);
+        return 2;
+    }
+    return 0;
+}
+
+// Expands directories into the .wbs files beneath them, sorted so builds are reproducible
+bool collectFiles(const Options& options, std::vector<fs::path>& files) {
+    bool ok = true;
+    for (const fs::path& input : options.inputs) {
+        std::error_code ec;
+        if (fs::is_directory(input, ec)) {
+            std::vector<fs::path> found;
+            for (auto it = fs::recursive_directory_iterator(input, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+                if (it->is_regular_file() && it->path().extension() == ".wbs") found.push_back(it->path());
+            if (ec) {
+                std::cerr << "wbsc: cannot read directory " << input << ": " << ec.message() << "\n";
+                ok = false;
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        } else if (fs::is_regular_file(input, ec)) files.push_back(input);
+        else {
+            std::cerr << "wbsc: no such file or directory " << input << "\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool compileFile(const fs::path& path, PhaseTimes& times) {
+    auto start = Clock::now();
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "wbsc: cannot open " << path << "\n";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+    times.read = millisSince(start);
+    times.bytes = text.size();
+    times.files = 1;
+
+    // Every token is at least a byte, so anything shorter than the tree's threshold never builds in parallel.
+    // It is lexed as the tree takes the tokens, so its lexing is counted in with the tree
+    IntermediateNode root;
+    TokenParser parser;
+    if (text.size() < IntermediateNode::defaultParallelThreshold || std::thread::hardware_concurrency() < 2) {
+        start = Clock::now();
+        root.generateTree(text);
+        times.tree = millisSince(start);
+        times.streamed = 1;
+    } else {
+        start = Clock::now();
+        const auto &tokens = parser.lex(text);
+        times.lex = millisSince(start);
+
+        start = Clock::now();
+        root.generateTree(text, tokens);
+        times.tree = millisSince(start);
+    }
+    times.tokens = root.getTokenCount();
+    times.nodes = root.getNodeCount();
+
+    start = Clock::now();
+    std::vector<SyntaxError> errors = root.getErrors();
+    times.check = millisSince(start);
+    times.errors = errors.size();
+    // Only worked out when there is something to show
+    if (!errors.empty()) {
+        SourceLines lines(text);
+        for (const SyntaxError& error : errors) {
+            std::cerr << path.string() << ": ";
+            error.printMessage(std::cerr, lines);
+        }
+    }
+    return true;
+}
+
+// Same output the editor's Generate action produces
+bool generate(const fs::path& output) {
+    std::ofstream file(output, std::ios::binary);
+    if (!file) {
+        std::cerr << "wbsc: cannot write " << output << "\n";
+        return false;
+    }
+    file << "<?php // This is an empty generated file. ?>";
+    return true;
+}
+
+void printTimes(const std::string& name, const PhaseTimes& times) {
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(3) << std::setw(10) << times.read;
+    // Nothing was lexed on its own when every file was streamed
+    if (times.files != 0 && times.streamed == times.files) std::cout << std::setw(10) << "-";
+    else std::cout << std::setw(10) << times.lex;
+    std::cout << std::setw(10) << times.tree
+              << std::setw(10) << times.check << std::setw(12) << times.bytes << std::setw(10) << times.tokens
+              << std::setw(10) << times.nodes << std::setw(10) << times.errors << "\n";
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (int status = parseArguments(argc, argv, options); status != 0) return status < 0 ? 0 : status;
+    if (!options.benchmark.empty()) return runBenchmark(options.benchmark, options.benchmarkSize, std::cout);
+
+    std::vector<fs::path> files;
+    bool ok = collectFiles(options, files);
+
+    if (!options.quiet)
+        std::cout << std::left << std::setw(40) << "file" << std::right << std::setw(10) << "read ms" << std::setw(10)
+                  << "lex ms" << std::setw(10) << "tree ms" << std::setw(10) << "check ms" << std::setw(12) << "bytes"
+                  << std::setw(10) << "tokens" << std::setw(10) << "nodes" << std::setw(10) << "errors" << "\n";
+
+    PhaseTimes total;
+    auto start = Clock::now();
+    for (const fs::path& path : files) {
+        PhaseTimes times;
+        if (!compileFile(path, times)) {
+            ok = false;
+            continue;
+        }
+        total += times;
+        if (!options.quiet) printTimes(path.string(), times);
+        // The errors are already printed, every file is still checked so they are all shown in one go
+        if (times.errors != 0) ok = false;
+    }
+
+    // Nothing is generated for a project that did not pass the check
+    double generateTime = 0;
+    if (options.generate && ok) {
+        fs::path output = options.output;
+        if (output.empty())
+            output = (options.inputs.size() == 1 && fs::is_directory(options.inputs[0]) ? options.inputs[0] : fs::path(".")) / "website.php";
+        auto generateStart = Clock::now();
+        ok = generate(output);
+        generateTime = millisSince(generateStart);
+    }
+
+    if (!options.quiet) {
+        printTimes("total (" + std::to_string(files.size()) + " files)", total);
+        if (total.streamed != 0)
+            std::cout << "lex ms: " << total.streamed << " of the files were lexed as their tree was built, "
+                      << "their lexing is counted in tree ms\n";
+        std::cout << "generate ms: " << std::fixed << std::setprecision(3) << generateTime
+                  << ", wall ms: " << millisSince(start) << "\n";
+    }
+    return ok ? 0 : 1;
+}
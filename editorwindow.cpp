@@ -22,6 +22,10 @@ PURPOSE:
 #include <QStandardPaths>
 #include <QHeaderView>
 #include <QScrollBar>
+#include <QStatusBar>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <algorithm>
 #include <cmath>
 
 EditorWindow::EditorWindow() {
@@ -37,6 +41,20 @@ EditorWindow::EditorWindow() {
     syntaxHighlighter = new SyntaxHighlighter(textEdit->document());
     textEdit->setInputMethodHints(Qt::ImhNone);
 
+    // Parse on a background thread once typing pauses, every edit is passed on as it happens
+    parseWorker = new ParseWorker(this);
+    parseTimer = new QTimer(this);
+    parseTimer->setSingleShot(true);
+    parseTimer->setInterval(300);
+    connect(parseTimer, &QTimer::timeout, parseWorker, &ParseWorker::parse);
+    connect(textEdit->document(), &QTextDocument::contentsChange, this, &EditorWindow::documentChanged);
+    connect(parseWorker, &ParseWorker::parsed, this, &EditorWindow::parseFinished);
+    #ifdef DEBUG
+    connect(parseWorker, &ParseWorker::previewReady, this, &EditorWindow::showCompilationTree);
+    #endif
+    // Only errors in view are squiggled, so scrolling brings in the rest
+    connect(textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this, &EditorWindow::showErrors);
+
     // Create file tree view
     fileTree = new QTreeView(this);
     fileModel = new QFileSystemModel;
@@ -175,6 +193,74 @@ void EditorWindow::run() {
     }
 }
 
+void EditorWindow::documentChanged(int position, int charsRemoved, int charsAdded) {
+    (void)charsRemoved;
+    QTextDocument *document = textEdit->document();
+    // Every block from the one the change starts in to the one it ends in was rewritten
+    QTextBlock block = document->findBlock(position);
+    QTextBlock end = document->findBlock(std::min(position + charsAdded, document->characterCount() - 1));
+    std::vector<std::string> lines;
+    for (; block.isValid(); block = block.next()) {
+        lines.push_back(block.text().toStdString() + (block.next().isValid() ? "\n" : ""));
+        if (block == end) break;
+    }
+
+    // The blocks the document gained or lost were all among the rewritten ones
+    long long first = document->findBlock(position).blockNumber();
+    long long removed = (long long)lines.size() - (document->blockCount() - lineCount);
+    parseTimer->start();
+    if (lines.empty() || removed < 0 || first + removed > lineCount) {
+        // Out of step with the document, start again from every block
+        lines.clear();
+        for (block = document->begin(); block.isValid(); block = block.next())
+            lines.push_back(block.text().toStdString() + (block.next().isValid() ? "\n" : ""));
+        lineCount = document->blockCount();
+        parseWorker->reset(std::move(lines));
+        return;
+    }
+    lineCount = document->blockCount();
+    parseWorker->update(first, removed, std::move(lines));
+}
+
+void EditorWindow::parseFinished(const ParseWorker::Result &result) {
+    errors = result.errors;
+    errorPlaces = result.places;
+    showErrors();
+    #ifdef DEBUG
+    statusBar()->showMessage(QString("Parsed %1 tokens into %2 nodes with %3 errors in %4 ms")
+            .arg(result.tokens).arg(result.nodes).arg(result.errors.size()).arg(result.millis, 0, 'f', 2));
+    #endif
+}
+
+// Squiggles the errors on the lines in view, the list is sorted so they are found with a binary search
+void EditorWindow::showErrors() {
+    QTextDocument *document = textEdit->document();
+    int firstLine = textEdit->cursorForPosition(QPoint(0, 0)).blockNumber();
+    int lastLine = textEdit->cursorForPosition(QPoint(0, textEdit->viewport()->height())).blockNumber();
+
+    QTextCharFormat squiggle;
+    squiggle.setUnderlineStyle(QTextCharFormat::WaveUnderline);
+    squiggle.setUnderlineColor(Qt::red);
+    QList<QTextEdit::ExtraSelection> selections;
+    auto place = std::lower_bound(errorPlaces.begin(), errorPlaces.end(), (uint32_t)firstLine,
+            [](const ParseWorker::Place &at, uint32_t line) { return at.line < line; });
+    for (; place != errorPlaces.end(); ++place) {
+        if (place->line > (uint32_t)lastLine) break;
+        const SyntaxError &error = errors[place - errorPlaces.begin()];
+        QTextBlock block = document->findBlockByNumber(place->line);
+        if (!block.isValid()) continue;
+        // Error offsets count bytes, the block counts UTF-16 units, one that runs on past the line is cut off there
+        QByteArray utf8 = block.text().toUtf8();
+        int start = std::min<int>(place->column, utf8.size());
+        int end = std::min<int>(start + (int)error.getLength(), utf8.size());
+        QTextCursor cursor(block);
+        cursor.setPosition(block.position() + QString::fromUtf8(utf8.left(start)).size());
+        cursor.setPosition(block.position() + QString::fromUtf8(utf8.left(end)).size(), QTextCursor::KeepAnchor);
+        selections.append({cursor, squiggle});
+    }
+    textEdit->setExtraSelections(selections);
+}
+
 void EditorWindow::changeTheme() {
     QStringList themes = {"Default"};
 
@@ -209,6 +295,11 @@ void EditorWindow::changeTheme() {
 
 #ifdef DEBUG
 void EditorWindow::previewCompilation() {
+    // The parse thread sends the tree back to showCompilationTree()
+    parseWorker->preview();
+}
+
+void EditorWindow::showCompilationTree(const std::vector<std::string> &tokens) {
     // Custom QWidget to represent each node, I was trying to draw lines which is the whole purpose this class exists but I couldn't get them working properly and it aint that important
     class TreeLabel : public QWidget {
     public:
@@ -257,15 +348,6 @@ void EditorWindow::previewCompilation() {
         #endif
     };
 
-    // Parse
-    TokenParser parser;
-    auto toks = parser.parse(textEdit->toPlainText().toStdString());
-    IntermediateNode *inter = new IntermediateNode();
-    inter->generateTree(toks);
-    while (inter->getParent() != nullptr) inter = inter->getParent();
-    std::vector<std::string> tokens;
-    inter->getAsVector(tokens);
-
     // Create a popup window
     QDialog *popup = new QDialog(nullptr);
     popup->setWindowTitle("Binary Tree Representation of Tokens");
@@ -10,13 +10,14 @@ PURPOSE:
 #include "syntaxhighlighter.h"
 #include "binarytreehelper.hpp"
 #include "tokenparser.h"
-#include "syntaxhighlighter.h"
+#include "parseworker.h"
 #include <QMainWindow>
 #include <QTextEdit>
 #include <QTreeView>
 #include <QFileSystemModel>
 #include <QSettings>
 #include <QSplitter>
+#include <QTimer>
 
 class EditorWindow : public QMainWindow {
     Q_OBJECT
@@ -35,6 +36,11 @@ private:
     QSettings *settings;
 
     SyntaxHighlighter *syntaxHighlighter;
+    ParseWorker *parseWorker;
+    QTimer *parseTimer; // Holds off parsing until typing pauses
+    int lineCount = 1; // Blocks in the document as of the last change
+    std::vector<SyntaxError> errors; // From the last parse, sorted by position
+    std::vector<ParseWorker::Place> errorPlaces; // The line and column of each of them
 
     QString currentFilePath;
 
@@ -48,8 +54,12 @@ private:
     void saveFileAs();
     void run();
     void changeTheme();
+    void documentChanged(int position, int charsRemoved, int charsAdded);
+    void parseFinished(const ParseWorker::Result &result);
+    void showErrors();
     #ifdef DEBUG
     void previewCompilation();
+    void showCompilationTree(const std::vector<std::string> &tokens);
     #endif
     void loadTheme(const QString &themeFile);
     void saveSettings();
@@ -0,0 +1,128 @@
+/* flattree.cpp
+PURPOSE:
+- The intermediate tree laid out flat in pre-order with one array per field, so passes over the whole tree are scans over contiguous memory
+*/
+#include "flattree.h"
+#include "intermediatenode.h"
+#include <algorithm>
+#include <utility>
+
+FlatTree::FlatTree(IntermediateNode *node) {
+    reset(node);
+}
+
+void FlatTree::reset(IntermediateNode *node) {
+    types.clear();
+    integers.clear();
+    values.clear();
+    offsets.clear();
+    lengths.clear();
+    parents.clear();
+    sizes.clear();
+    if (node == nullptr || node->token.getType() == Token::TokenType::UNSET) return;
+    // The root's arena knows how many nodes there are without a walk
+    if (node->arena != nullptr) {
+        const size_t count = node->arena->size();
+        types.reserve(count);
+        integers.reserve(count);
+        values.reserve(count);
+        offsets.reserve(count);
+        lengths.reserve(count);
+        parents.reserve(count);
+        sizes.reserve(count);
+    }
+    IntermediateNode *root = node;
+    while (node->parent != nullptr) node = node->parent;
+    while (node->prevSibling != nullptr) node = node->prevSibling;
+
+    // The nodes still having their subtree added, an ancestor's size is known once the walk leaves it
+    std::vector<std::pair<IntermediateNode *, Index>> open;
+    auto close = [&]() {
+        sizes[open.back().second] = (uint32_t)types.size() - open.back().second;
+        open.pop_back();
+    };
+    size_t statement = 0;
+    uint32_t base = 0;
+    for (; node != nullptr; node = node->getNextInPreOrder(nullptr)) {
+        while (!open.empty() && open.back().first != node->parent) close();
+        // The linked tree counts offsets from the start of each top level statement, flat they are from the start of the text
+        if (node->parent == nullptr) base = root->getStatementOffset(statement++);
+        const Token &t = node->token;
+        parents.push_back(open.empty() ? none : open.back().second);
+        open.emplace_back(node, (Index)types.size());
+        types.push_back(t.type);
+        integers.push_back(t.integer);
+        values.push_back(t.value.integer);
+        offsets.push_back(base + t.offset);
+        lengths.push_back(t.length);
+        sizes.push_back(1);
+    }
+    while (!open.empty()) close();
+}
+
+uint32_t FlatTree::size() const {
+    return (uint32_t)types.size();
+}
+
+Token FlatTree::getToken(Index node) const {
+    Token t;
+    t.type = types[node];
+    t.integer = integers[node];
+    t.length = lengths[node];
+    t.offset = offsets[node];
+    t.value.integer = values[node];
+    return t;
+}
+
+Token::TokenType FlatTree::getType(Index node) const {
+    return types[node];
+}
+
+uint32_t FlatTree::getOffset(Index node) const {
+    return offsets[node];
+}
+
+uint32_t FlatTree::getLength(Index node) const {
+    return lengths[node];
+}
+
+FlatTree::Index FlatTree::getParent(Index node) const {
+    return parents[node];
+}
+
+FlatTree::Index FlatTree::getFirstChild(Index node) const {
+    return sizes[node] > 1 ? node + 1 : none;
+}
+
+FlatTree::Index FlatTree::getNextSibling(Index node) const {
+    const Index next = node + sizes[node], parent = parents[node];
+    const Index end = parent == none ? size() : parent + sizes[parent];
+    return next < end ? next : none;
+}
+
+uint32_t FlatTree::getNumberChildren(Index node) const {
+    uint32_t count = 0;
+    for (Index child = getFirstChild(node); child != none; child = getNextSibling(child)) ++count;
+    return count;
+}
+
+uint32_t FlatTree::getSubtreeSize(Index node) const {
+    return sizes[node];
+}
+
+// Each node is only visited again as one of its parent's children, so the whole check is still one pass
+std::vector<SyntaxError> FlatTree::getErrors() const {
+    std::vector<SyntaxError> errors;
+    for (Index node = 0; node < size(); ++node) {
+        uint32_t children = 0;
+        Index last = none;
+        for (Index child = getFirstChild(node); child != none; child = getNextSibling(child)) {
+            ++children;
+            last = child;
+        }
+        const Token lastChild = last != none ? getToken(last) : Token();
+        IntermediateNode::checkNode(getToken(node), children, last != none ? &lastChild : nullptr, errors);
+    }
+    std::stable_sort(errors.begin(), errors.end());
+    return errors;
+}
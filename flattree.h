@@ -0,0 +1,56 @@
+/* flattree.h
+PURPOSE:
+- The intermediate tree laid out flat in pre-order with one array per field, so passes over the whole tree are scans over contiguous memory
+- Made from an IntermediateNode tree, so whatever reads the tree can move over to it a pass at a time
+*/
+#ifndef FLATTREE_H
+#define FLATTREE_H
+
+#include "syntaxerror.hpp"
+#include "token.hpp"
+#include <cstdint>
+#include <vector>
+
+class IntermediateNode;
+
+class FlatTree {
+public:
+    // A node's index is its place in a pre-order walk of the tree, every top level statement one after another
+    using Index = uint32_t;
+    // What a node without a parent, first child or next sibling gets instead
+    static constexpr Index none = (Index)-1;
+
+    FlatTree() = default;
+    // Copies the whole tree the node is in, not just the part below it, from the root the tree was built on
+            // since that knows where each statement starts
+    explicit FlatTree(IntermediateNode *node);
+    void reset(IntermediateNode *node);
+
+    uint32_t size() const;
+    // Put back together from the arrays, the getters below only touch the one array they need
+    Token getToken(Index node) const;
+    Token::TokenType getType(Index node) const;
+    uint32_t getOffset(Index node) const;
+    uint32_t getLength(Index node) const;
+    Index getParent(Index node) const;
+    // Children come straight after their parent, so the first child is always the next node if there is one
+    Index getFirstChild(Index node) const;
+    // The node just past this one's subtree, unless that belongs to something else
+    Index getNextSibling(Index node) const;
+    uint32_t getNumberChildren(Index node) const;
+    // Counts the node and everything below it, node + getSubtreeSize(node) skips the lot
+    uint32_t getSubtreeSize(Index node) const;
+    // The same errors in the same order as IntermediateNode::getErrors()
+    std::vector<SyntaxError> getErrors() const;
+
+private:
+    std::vector<Token::TokenType> types;
+    std::vector<uint8_t> integers; // Which of the two a numeric literal is held as
+    std::vector<int64_t> values; // Symbol id or machine value, all 8 bytes of it
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<Index> parents;
+    std::vector<uint32_t> sizes;
+};
+
+#endif // FLATTREE_H
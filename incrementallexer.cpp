@@ -0,0 +1,161 @@
+/* incrementallexer.cpp
+PURPOSE:
+- Keeps the tokens of an open document up to date by re-lexing only the lines an edit touched
+*/
+#include "incrementallexer.h"
+#include <algorithm>
+
+IncrementalLexer::IncrementalLexer() {
+    reset({});
+}
+
+void IncrementalLexer::reset(std::vector<std::string> newLines) {
+    if (newLines.empty()) newLines.emplace_back();
+    lines.clear();
+    std::vector<Line> added(newLines.size());
+    std::vector<ChunkedList<Line, 2>::Sizes> counts(newLines.size());
+    for (size_t i = 0; i < newLines.size(); ++i) {
+        counts[i] = {0, newLines[i].size()};
+        added[i].text = std::move(newLines[i]);
+    }
+    lines.insert(0, std::move(added), counts);
+    relex(0, lines.size(), 0, false);
+}
+
+IncrementalLexer::LineRange IncrementalLexer::update(size_t first, size_t removed, std::vector<std::string> newLines) {
+    first = std::min(first, lines.size());
+    removed = std::min(removed, lines.size() - first);
+    // The first new line starts however the line before it ended, which the edit did not touch
+    bool startsInString = first < lines.size() ? lines[first].startsInString : false;
+    size_t removedTokens = lines.getBefore(first + removed, TOKENS) - lines.getBefore(first, TOKENS);
+
+    lines.erase(first, removed);
+    std::vector<Line> added(newLines.size());
+    std::vector<ChunkedList<Line, 2>::Sizes> counts(newLines.size());
+    for (size_t i = 0; i < newLines.size(); ++i) {
+        counts[i] = {0, newLines[i].size()};
+        added[i].text = std::move(newLines[i]);
+    }
+    lines.insert(first, std::move(added), counts);
+    if (lines.empty()) lines.insert(0, {Line()}, {{0, 0}});
+    // A line that survived the edit keeps how it started last time, relex() compares against it to know when to stop
+    if (!newLines.empty()) lines[first].startsInString = startsInString;
+
+    // At least the first line after the edit is lexed again, after a pure deletion it is the only one that can have changed
+    const size_t editEnd = first + std::max<size_t>(newLines.size(), 1);
+    // Nothing survived after the edit, so the line before it either became the last one and has to finish off the token
+            // it ends in, or was the last one and is what an appended line carries on from
+    if (first > 0 && first + newLines.size() == lines.size()) startsInString = lines[--first].startsInString;
+    return relex(first, editEnd, removedTokens, startsInString);
+}
+
+IncrementalLexer::LineRange IncrementalLexer::relex(size_t first, size_t editEnd, size_t removedTokens, bool startsInString) {
+    // A line that starts inside a string has its tokens owned by the line the string began on, so start from there
+    size_t begin = first;
+    while (begin > 0 && startsInString) startsInString = lines[--begin].startsInString;
+    const size_t firstToken = lines.getBefore(begin, TOKENS);
+
+    // Offsets are counted from the start of begin while lexing and moved to be relative to each token's own line
+    LexState state;
+    size_t pendingOwner = begin; // The line the token still being built started on
+    uint32_t pendingBase = 0;
+    size_t i = begin;
+    for (; i < lines.size(); ++i) {
+        Line &current = lines[i];
+        // Past the edit, once a line starts the same as it did before, it and everything after it is unchanged
+        if (i >= editEnd && !state.inString && !current.startsInString) break;
+
+        current.startsInString = state.inString;
+        removedTokens += current.tokens.size();
+        current.tokens.clear();
+        const uint32_t lineBase = state.offset;
+        emitted.clear();
+        TokenParser::lexChunk(current.text, state, emitted);
+        if (i + 1 == lines.size()) TokenParser::lexFinish(state, emitted);
+
+        for (LexToken token : emitted) {
+            const bool own = token.offset >= lineBase;
+            token.offset -= own ? lineBase : pendingBase;
+            (own ? current : lines[pendingOwner]).tokens.push_back(token);
+        }
+        if (state.tokenStart != LexState::none && state.tokenStart >= lineBase) {
+            pendingOwner = i;
+            pendingBase = lineBase;
+        }
+    }
+    size_t addedTokens = 0;
+    for (size_t line = begin; line < i; ++line) {
+        const Line &lexed = lines[line];
+        addedTokens += lexed.tokens.size();
+        lines.setCounts(line, {lexed.tokens.size(), lexed.text.size()});
+    }
+    return {begin, i - begin, firstToken, removedTokens, addedTokens};
+}
+
+size_t IncrementalLexer::getLineCount() const {
+    return lines.size();
+}
+
+const std::string& IncrementalLexer::getLine(size_t line) const {
+    return lines[line].text;
+}
+
+const std::vector<LexToken>& IncrementalLexer::getLineTokens(size_t line) const {
+    return lines[line].tokens;
+}
+
+bool IncrementalLexer::startsInString(size_t line) const {
+    return lines[line].startsInString;
+}
+
+std::vector<LexToken> IncrementalLexer::getTokens() const {
+    std::vector<LexToken> tokens;
+    tokens.reserve(lines.getTotal(TOKENS));
+    uint32_t offset = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        for (LexToken token : lines[i].tokens) {
+            token.offset += offset;
+            tokens.push_back(token);
+        }
+        offset += (uint32_t)lines[i].text.size();
+    }
+    return tokens;
+}
+
+std::string IncrementalLexer::getText() const {
+    std::string text;
+    text.reserve(lines.getTotal(BYTES));
+    for (size_t i = 0; i < lines.size(); ++i) text += lines[i].text;
+    return text;
+}
+
+size_t IncrementalLexer::getTokenCount() const {
+    return lines.getTotal(TOKENS);
+}
+
+LexToken IncrementalLexer::getToken(size_t index) const {
+    const size_t line = lines.find(index, TOKENS);
+    LexToken token = lines[line].tokens[index - lines.getBefore(line, TOKENS)];
+    token.offset += (uint32_t)lines.getBefore(line, BYTES);
+    return token;
+}
+
+std::string_view IncrementalLexer::getTokenText(LexToken token, std::string &scratch) const {
+    size_t line = getLineAt(token.offset);
+    size_t start = token.offset - lines.getBefore(line, BYTES);
+    std::string_view text = lines[line].text;
+    if (start + token.length <= text.size()) return text.substr(start, token.length);
+    // Only strings run over a line break, the rest of it is on the lines after
+    scratch.assign(text.substr(start));
+    while (scratch.size() < token.length && ++line < lines.size())
+        scratch.append(lines[line].text, 0, token.length - scratch.size());
+    return scratch;
+}
+
+size_t IncrementalLexer::getLineAt(size_t offset) const {
+    return offset < lines.getTotal(BYTES) ? lines.find(offset, BYTES) : lines.size() - 1;
+}
+
+size_t IncrementalLexer::getLineStart(size_t line) const {
+    return lines.getBefore(line, BYTES);
+}
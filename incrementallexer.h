@@ -0,0 +1,71 @@
+/* incrementallexer.h
+PURPOSE:
+- Keeps the tokens of an open document up to date by re-lexing only the lines an edit touched
+*/
+#ifndef INCREMENTALLEXER_H
+#define INCREMENTALLEXER_H
+
+#include "tokenparser.h"
+#include "chunkedlist.hpp"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class IncrementalLexer {
+public:
+    // The lines that were re-lexed by an update, every other line kept its tokens
+    struct LineRange {
+        size_t first, count;
+        // The same span in tokens of the whole text, from the first one and how many there were before and after
+        size_t firstToken, removedTokens, addedTokens;
+    };
+
+    // Starts off as a single empty line, same as an empty document
+    IncrementalLexer();
+
+    // Lexes every line from scratch, every line but the last ends with its '\n'
+    void reset(std::vector<std::string> lines);
+    // Replaces the removed lines starting at first with the given ones, then re-lexes from there
+    // until the lexer state at the start of a line is the same as it was last time
+    LineRange update(size_t first, size_t removed, std::vector<std::string> lines);
+
+    size_t getLineCount() const;
+    const std::string& getLine(size_t line) const;
+    // Tokens that start on the line, with offsets from the start of the line
+    const std::vector<LexToken>& getLineTokens(size_t line) const;
+    // Strings are the only thing that can carry on over a line break
+    bool startsInString(size_t line) const;
+    // Every token positioned in the whole text, the same as TokenParser::lex() gives for getText()
+    std::vector<LexToken> getTokens() const;
+    std::string getText() const;
+
+    // The same as getTokens() gives one at a time, each is a lookup so reading a few does not put together all of them
+    size_t getTokenCount() const;
+    LexToken getToken(size_t index) const;
+    // A token's text, only copied into scratch when it carries on past the line it starts on
+    std::string_view getTokenText(LexToken token, std::string &scratch) const;
+    // The line a byte of the whole text is on and where in the text a line starts
+    size_t getLineAt(size_t offset) const;
+    size_t getLineStart(size_t line) const;
+
+private:
+    struct Line {
+        std::string text;
+        std::vector<LexToken> tokens;
+        bool startsInString = false;
+    };
+
+    // Each line counts the tokens it owns and its bytes, so where a line starts in either is a lookup and not a sum
+    enum Count {
+        TOKENS,
+        BYTES
+    };
+    ChunkedList<Line, 2> lines;
+    std::vector<LexToken> emitted; // Reused between lines so lexing a line does not allocate
+
+    // startsInString is how first starts, the edit can have left the line there with what it had before
+    LineRange relex(size_t first, size_t editEnd, size_t removedTokens, bool startsInString);
+};
+
+#endif // INCREMENTALLEXER_H
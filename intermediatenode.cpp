@@ -3,355 +3,685 @@ PURPOSE:
 - Takes in tokens and produces an intermediate structure for use in exporting based on phrases
 */
 #include "intermediatenode.h"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
-#include <math.h>
-
-void IntermediateNode::generateTree(std::vector<std::tuple<std::string, uint32_t, uint32_t>> tokens) {
-    if (token.getType() != Token::TokenType::UNSET) destroy();
+#include <thread>
+
+void IntermediateNode::generateTree(std::string_view source, const std::vector<LexToken> &tokens) {
+    beginBuild();
+    const unsigned pieces = record->threads != 0 ? record->threads : std::thread::hardware_concurrency();
+    if (record->parallelThreshold != 0 && tokens.size() >= record->parallelThreshold && pieces > 1) {
+        generateTreeParallel(source, tokens, pieces);
+        return;
+    }
+    BuildState state;
+    const BuildTarget target = rootTarget();
+    uint32_t countdown = stopInterval;
+    while (state.tokens < tokens.size()) {
+        if (isStopped(countdown)) return abandonBuild();
+        const uint32_t i = state.tokens;
+        addToken({tokens[i].text(source), tokens[i].offset}, textAt(source, tokens, i + 1), state, target);
+    }
+    endBuild(state);
+}
 
-    IntermediateNode *lastTopLevel = nullptr; // The last top level node
-    IntermediateNode *last = nullptr; // The last childless node so that it is the bottom, the place where we are adding from
-    IntermediateNode *lastlast = last; // The previous value in last, likely not a childless/bottom node
-
-    for (std::tuple<std::string, uint32_t, uint32_t> tuple : tokens) {
-        std::string value = std::get<0>(tuple);
-        uint32_t line = std::get<1>(tuple);
-        uint32_t pos = std::get<2>(tuple);
-        bool first = true, inLink = false, inHtml = false;
-        if (last != nullptr) {
-            if (last->token.getType() == Token::TokenType::KEYWORD &&
-                    (last->token.getValue() == "open" ||
-                    last->token.getValue() == "file"))
-                inLink = true;
-            else if (last->getParent() != nullptr &&
-                    (last->getParent()->token.getType() == Token::TokenType::FILE_LITERAL ||
-                    (last->getParent()->token.getType() == Token::TokenType::KEYWORD &&
-                    (last->getParent()->token.getValue() == "open" ||
-                    last->getParent()->token.getValue() == "file"))))
-                inLink = true;
-            if (Token::getPhraseLength(last->token) > last->getNumberChildren())
-                first = last->token.getType() == Token::TokenType::BINARY_OPERATOR ||
-                        last->getNumberChildren() > 0;
-                // Because binary operators are not in order it should always consider it to be first
-            else if (last->getParent() != nullptr)
-                first = last->getParent()->token.getType() == Token::TokenType::BINARY_OPERATOR ||
-                        Token::getPhraseLength(last->getParent()->token) <= last->getParent()->getNumberChildren();
-                // Because binary operators are not in order it should always consider it to be first
-            if (last->token.getType() == Token::TokenType::KEYWORD &&
-                    last->token.getValue() == "create")
-                inHtml = true;
+void IntermediateNode::generateTree(std::string_view source) {
+    beginBuild();
+    BuildState state;
+    const BuildTarget target = rootTarget();
+    LexCursor cursor(source);
+    // One token is read ahead, for when the one before it joins up with it
+    LexToken current, next;
+    bool more = cursor.next(current);
+    uint32_t countdown = stopInterval;
+    while (more) {
+        if (isStopped(countdown)) return abandonBuild();
+        const bool ahead = cursor.next(next);
+        const uint32_t count = state.tokens;
+        addToken({current.text(source), current.offset}, ahead ? TokenText{next.text(source), next.offset} : TokenText{{}, 0},
+                state, target);
+        if (state.tokens - count == 2) more = cursor.next(current);
+        else {
+            current = next;
+            more = ahead;
         }
-        Token cToken = Token(Token::getLiteral(value, inLink), value, line,
-                pos, first, inLink, inHtml);
+    }
+    endBuild(state);
+}
 
-        // We have to go through some special cases before getting to the nice stuff
+void IntermediateNode::generateTree(const std::vector<std::tuple<std::string, uint32_t>> &tokens) {
+    beginBuild();
+    BuildState state;
+    const BuildTarget target = rootTarget();
+    uint32_t countdown = stopInterval;
+    while (state.tokens < tokens.size()) {
+        if (isStopped(countdown)) return abandonBuild();
+        const uint32_t i = state.tokens;
+        const TokenText next = i + 1 < tokens.size() ? TokenText{std::get<0>(tokens[i + 1]), std::get<1>(tokens[i + 1])} : TokenText{{}, 0};
+        addToken({std::get<0>(tokens[i]), std::get<1>(tokens[i])}, next, state, target);
+    }
+    endBuild(state);
+}
 
-        // The first token is always special, it just becomes the first token
-        if (last == nullptr) {
-            lastlast = nullptr;
-            last = this;
-            lastTopLevel = this;
-            token = cToken;
-            continue;
+void IntermediateNode::generateTreeParallel(std::string_view source, const std::vector<LexToken> &tokens, unsigned count) {
+    // Each split is moved on to the first token that is a const or keyword at the start of a line, the likeliest start of a statement
+    std::vector<uint32_t> splits = {0};
+    for (unsigned i = 1; i < count; ++i) {
+        size_t split = std::max<size_t>(splits.back() + 1, tokens.size() / count * i);
+        for (; split < tokens.size(); ++split) {
+            const uint32_t gap = tokens[split - 1].offset + tokens[split - 1].length;
+            if (source.substr(gap, tokens[split].offset - gap).find('\n') == std::string_view::npos) continue;
+            Token::TokenType type = Token::getLiteral(tokens[split].text(source), false);
+            if (type == Token::TokenType::CONST || type == Token::TokenType::KEYWORD) break;
         }
-
-        // Assignments are always special
-        if (cToken.getType() == Token::TokenType::ASSIGNMENT) {
-            // If the last element is not part of a const or argument list automatically assume equality
-            if (last->getParent() == nullptr ||
-                    (last->getParent()->token.getType() != Token::TokenType::CONST &&
-                    last->getParent()->token.getType() != Token::TokenType::ARGUMENT_LIST))
-                cToken = Token(Token::TokenType::BINARY_OPERATOR, "=", // This does mean there is both a "=" and "==" binary operator that function the same, but if I were to make this == you wouldn't be able to explicitly type "==" for the binary equality
-                        cToken.getLine(), cToken.getPos());
-            // Double equals will always be equality
-            if (last->getParent() != nullptr && last->getParent()->getNumberChildren() == 1 &&
-                    (last->getParent()->token.getType() == Token::TokenType::BINARY_OPERATOR ||
-                    last->getParent()->token.getType() == Token::TokenType::ASSIGNMENT) &&
-                    last->getParent()->token.getValue() == "=") {
-                last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "==",
-                        last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                continue; // Just need to adjust and move on since it's not a new token
-            }
-            // Can merge with '>' and '<'
-            if (last->getParent() != nullptr && last->getParent()->getNumberChildren() == 1 &&
-                    last->getParent()->token.getType() == Token::TokenType::BINARY_OPERATOR) {
-                if (last->getParent()->token.getValue() == "<")
-                    last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "≤",
-                            last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                if (last->getParent()->token.getValue() == ">")
-                    last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "≥",
-                            last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                continue; // Just need to adjust and move on since it's not a new token
-            }
-            // Can also merge with '!' and '~'
-            if (last->token.getType() == Token::TokenType::UNARY_OPERATOR) {
-                if (last->token.getValue() == "!" || last->token.getValue() == "not")
-                    last->token = Token(Token::TokenType::BINARY_OPERATOR, "≠",
-                            last->token.getLine(), last->token.getPos());
-                else if (last->token.getValue() == "~")
-                    last->token = Token(Token::TokenType::BINARY_OPERATOR, "≈",
-                            last->token.getLine(), last->token.getPos());
-                // If either of the above ran:
-                if (last->token.getType() == Token::TokenType::BINARY_OPERATOR) {
-                    // Since as a unary operator it would have started its own phrase and left like the LHS of this expression we need to merge
-                    if (lastlast != nullptr) {
-                        if (lastlast->previous != nullptr) {
-                            if (lastlast->hasParent) lastlast->previous->firstChild = last;
-                            else lastlast->previous->nextSibling = last;
-                        } if (lastlast->nextSibling != nullptr && lastlast->nextSibling != last)
-                            lastlast->nextSibling->previous = last;
-                        last->hasParent = lastlast->hasParent;
-                        last->previous = lastlast->previous;
-                        last->firstChild = lastlast;
-                        last->nextSibling = lastlast->nextSibling == last ? nullptr : lastlast->nextSibling;
-                        lastlast->hasParent = true;
-                        lastlast->previous = last;
-                        lastlast->nextSibling = nullptr;
-                        last = lastlast; // These two lines just swap last and lastlast
-                        lastlast = last->previous;
-                    }
-                    continue; // Just need to adjust and move on since it's not a new token
+        if (split >= tokens.size()) break;
+        splits.push_back((uint32_t)split);
+    }
+    splits.push_back((uint32_t)tokens.size());
+
+    // The pieces after the first are built apart from the tree, with arenas of their own
+    struct Piece {
+        std::unique_ptr<NodeArena> arena = std::make_unique<NodeArena>();
+        std::vector<Statement> statements;
+        IntermediateNode *first = nullptr;
+        Token firstToken; // As it was made, it can since have been merged with or closed
+        BuildState state;
+    };
+    std::vector<Piece> pieces(splits.size() - 2);
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopped = false;
+    for (size_t p = 0; p < pieces.size(); ++p) {
+        workers.emplace_back([&, p] {
+            Piece &piece = pieces[p];
+            piece.first = piece.arena->make();
+            const BuildTarget target = {piece.arena.get(), &piece.statements, piece.first};
+            uint32_t countdown = stopInterval;
+            // The piece counts its tokens from 0, as if it began the file
+            for (uint32_t i = splits[p + 1]; i < splits[p + 2]; i = splits[p + 1] + piece.state.tokens) {
+                if (stopped || isStopped(countdown)) {
+                    stopped = true;
+                    return;
                 }
+                addToken({tokens[i].text(source), tokens[i].offset}, textAt(source, tokens, i + 1), piece.state, target);
+                if (i == splits[p + 1]) piece.firstToken = piece.first->token;
             }
+        });
+    }
 
-            // Need to replace last node and then have it as a child
-            IntermediateNode *newNode = new IntermediateNode();
-            newNode->token = cToken;
-            if (last->previous != nullptr) {
-                if (last->hasParent) last->previous->firstChild = newNode;
-                else last->previous->nextSibling = newNode;
-            } if (last->nextSibling != nullptr) last->nextSibling->previous = newNode;
-            newNode->hasParent = last->hasParent;
-            newNode->previous = last->previous;
-            newNode->firstChild = last;
-            newNode->nextSibling = last->nextSibling;
-            last->hasParent = true;
-            last->previous = newNode;
-            last->nextSibling = nullptr;
-            lastlast = newNode;
+    BuildState state;
+    const BuildTarget target = rootTarget();
+    uint32_t countdown = stopInterval;
+    auto add = [&](uint32_t from, uint32_t to) {
+        for (uint32_t i = from; i < to && !stopped; i = state.tokens) {
+            if (isStopped(countdown)) stopped = true;
+            else addToken({tokens[i].text(source), tokens[i].offset}, textAt(source, tokens, i + 1), state, target);
+        }
+    };
+    add(0, splits[1]);
+    for (std::thread &worker : workers) worker.join();
+    if (stopped) return abandonBuild();
+
+    for (size_t p = 0; p < pieces.size(); ++p) {
+        Piece &piece = pieces[p];
+        const uint32_t split = splits[p + 1];
+        // The split token is added for real first, the piece is only right if it started a statement from the same token.
+                // After that nothing reaches back into the statements before, operators only climb as far as the top of their own
+        const BuildState before = state;
+        const size_t count = record->made.size();
+        add(split, split + 1);
+        IntermediateNode *made = record->made.size() == count + 1 ? record->made.back().node : nullptr;
+        const bool same = made != nullptr && made == state.last && state.tokens == split + 1 &&
+                made->token.getType() == piece.firstToken.getType() && made->token.hasSameValue(piece.firstToken);
+        if (!same) {
+            add(state.tokens, splits[p + 2]);
+            if (stopped) return abandonBuild();
             continue;
         }
 
-        // Binary Operators are always special
-        if(cToken.getType() == Token::TokenType::BINARY_OPERATOR) {
-            // '*', '/', '^', '&', and '|', can all double up
-            if (last->getParent() != nullptr && last->getParent()->getNumberChildren() == 1 &&
-                    last->getParent()->token.getType() == Token::TokenType::BINARY_OPERATOR && 
-                    last->getParent()->token.getValue() == cToken.getValue()) {
-                if(cToken.getValue() == "*")
-                    last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "**",
-                            last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                else if(cToken.getValue() == "/")
-                    last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "//",
-                            last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                else if(cToken.getValue() == "^")
-                    last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "xor",
-                            last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                else if(cToken.getValue() == "&")
-                    last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "and",
-                            last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                else if(cToken.getValue() == "|")
-                    last->getParent()->token = Token(Token::TokenType::BINARY_OPERATOR, "or",
-                            last->getParent()->token.getLine(), last->getParent()->token.getPos());
-                continue; // Just need to adjust and move on since it's not a new token
-            }
+        // Swap the statement just made for the piece's
+        IntermediateNode *older = made->prevSibling;
+        made->unlink();
+        release(made);
+        record->made.pop_back();
+        IntermediateNode *top = piece.first;
+        while (top->parent != nullptr) top = top->parent;
+        older->nextSibling = top;
+        top->prevSibling = older;
+
+        // The piece counted its tokens from 0
+        piece.statements.front().before = before;
+        for (size_t i = 1; i < piece.statements.size(); ++i) piece.statements[i].before.tokens += split;
+        record->made.insert(record->made.end(), piece.statements.begin(), piece.statements.end());
+        state = piece.state;
+        state.tokens += split;
+        arena->adopt(std::move(piece.arena));
+    }
+    endBuild(state);
+}
 
-            // '/' merges with file literals
-            if (cToken.getValue() == "/" &&
-                    last->token.getType() == Token::TokenType::FILE_LITERAL) {
-                last->token.setValue(last->token.getValue() + "/");
-                continue; // Merging so not creating a new token
-            }
-            
-            // Otherwise gobble up, replace last node and then have it as a child
-            IntermediateNode *newNode = new IntermediateNode();
-            newNode->token = cToken;
-            if (last->previous != nullptr) {
-                if (last->hasParent) last->previous->firstChild = newNode;
-                else last->previous->nextSibling = newNode;
-            } if (last->nextSibling != nullptr) last->nextSibling->previous = newNode;
-            newNode->hasParent = last->hasParent;
-            newNode->previous = last->previous;
-            newNode->firstChild = last;
-            newNode->nextSibling = last->nextSibling;
-            last->hasParent = true;
-            last->previous = newNode;
-            last->nextSibling = nullptr;
-            lastlast = newNode;
-            continue;
-            
-            // TODO: I suppose it is right above where I would deal with reordering, like this one should always be put below if the last one was an operation unless this one was higher priority (strictly higher since it came after)
+uint32_t IntermediateNode::getTokenCount() {
+    return record != nullptr ? record->tokens : 0;
+}
+
+void IntermediateNode::setParallelThreshold(size_t tokens) {
+    if (record == nullptr) record = std::make_unique<BuildRecord>();
+    record->parallelThreshold = tokens;
+}
+
+void IntermediateNode::setThreads(unsigned threads) {
+    if (record == nullptr) record = std::make_unique<BuildRecord>();
+    record->threads = threads;
+}
+
+void IntermediateNode::setStopCheck(std::function<bool()> stop) {
+    if (record == nullptr) record = std::make_unique<BuildRecord>();
+    record->stop = std::move(stop);
+}
+
+void IntermediateNode::updateTree(std::string_view source, const std::vector<LexToken> &tokens, const TokenEdit &edit) {
+    if (!updateTree(tokens.size(), [&](size_t index) { return textAt(source, tokens, index); }, edit)) generateTree(source, tokens);
+}
+
+bool IntermediateNode::updateTree(size_t count, const TokenLookup &lookup, const TokenEdit &edit) {
+    if (record == nullptr || record->statements.empty() ||
+            (int64_t)record->tokens + edit.added - edit.removed != (int64_t)count)
+        return false;
+    ChunkedList<Statement, 3> &statements = record->statements;
+
+    // The last statement to start at or before the token two before the edit, its first token and the one it looked ahead at
+            // are both the same as last time so it starts the same way, and every token before it builds the same as last time
+    const size_t restart = statements.find(edit.first > 1 ? edit.first - 2 : 0, TOKENS);
+    IntermediateNode *cut = statements[restart].node;
+    while (cut->parent != nullptr) cut = cut->parent;
+    // The root belongs to the first statement, so an edit there is a full rebuild
+    if (restart == 0 || cut->prevSibling == nullptr) return false;
+
+    // Take the old statements from there on off the end of the tree, the edit gets built where they were.
+            // Their records stay where they are until the build is done, so the old starts can still be looked up
+    BuildState state = statements[restart].before;
+    state.tokens = (uint32_t)statements.getBefore(restart, TOKENS);
+    state.base = getStatementOffset(restart - 1);
+    cut->prevSibling->nextSibling = nullptr;
+    cut->prevSibling = nullptr;
+
+    const int64_t shift = (int64_t)edit.added - edit.removed;
+    size_t next = restart + 1; // The next old statement that the build could fall back in step with
+    uint64_t nextStart = state.tokens + statements.getCount(restart, TOKENS);
+    size_t kept = statements.size(); // The first old statement kept, none unless the build falls back in step
+    std::vector<Statement> &made = record->made;
+    made.clear();
+    const BuildTarget target = rootTarget();
+    // The token looked ahead at is kept for when it is added next, so each is only looked up once
+    auto at = [&](size_t index) { return index < count ? lookup(index) : TokenText{{}, 0}; };
+    TokenText ahead = at(state.tokens);
+    uint32_t aheadIndex = state.tokens, countdown = stopInterval;
+    while (state.tokens < count) {
+        if (isStopped(countdown)) {
+            abandonBuild();
+            return true;
         }
+        const uint32_t index = state.tokens;
+        const size_t statementCount = made.size();
+        const TokenText text = aheadIndex == index ? ahead : at(index);
+        ahead = at(index + 1);
+        aheadIndex = index + 1;
+        addToken(text, ahead, state, target);
+        if (made.size() <= statementCount || index < edit.first + edit.added) continue;
+
+        // A statement past the edit started, if an old one started on the same token as the same type of node
+                // then nothing before it can reach into it and every statement from there on is unchanged
+        for (; next < statements.size() && (int64_t)nextStart + shift < index; ++next) nextStart += statements.getCount(next, TOKENS);
+        if (next == statements.size()) continue;
+        const Statement &old = statements[next];
+        if ((int64_t)nextStart + shift != index || old.node->token.getType() != made.back().node->token.getType()) continue;
+
+        IntermediateNode *top = old.node;
+        while (top->parent != nullptr) top = top->parent;
+        top->prevSibling->nextSibling = nullptr;
+        // The node just made is childless and the youngest top level one, the old statement goes in its place
+        IntermediateNode *node = made.back().node;
+        IntermediateNode *older = node->prevSibling;
+        node->unlink();
+        arena->release(node);
+        older->nextSibling = top;
+        top->prevSibling = older;
+        // Its offsets are counted from its own start, so nothing in it has to move along with it
+        made.back().node = old.node;
+        kept = next;
+        break;
+    }
 
-        // Unary Operators, only the unary '/' (only meant to be used for starting a file literal)
-                // and the unary '(' since it might be an argument list '(' are special
-        if (cToken.getType() == Token::TokenType::UNARY_OPERATOR) {
-            // A unary '/' just makes a blank file literal, allowing you to make one at any point if you so wanted, though again it is just a string its not typed
-                    // just has some extra features in that you can be warned if it's not found, and it can be placed in subdirectories and still be found
-            if (cToken.getValue() == "/")
-                cToken = Token(Token::TokenType::FILE_LITERAL, "", cToken.getLine(), cToken.getPos());
-            else if (cToken.getValue() == "(") {
-                // Make argument expression if possible, since it only replaces a value expression or an htmlpart it will always be acceptable so no need to check
-                if (last->token.getType() == Token::TokenType::HTMLPART || 
-                        (Token::isValueExpression(last->token) &&
-                        last->isComplete())) {
-                    // Make a binary '(' and swap it with last
-                    IntermediateNode *newNode = new IntermediateNode();
-                    newNode->token = Token(Token::TokenType::BINARY_OPERATOR, cToken.getValue(), cToken.getLine(), cToken.getPos());
-                    if (last->previous != nullptr) {
-                        if (last->hasParent) last->previous->firstChild = newNode;
-                        else last->previous->nextSibling = newNode;
-                    } if (last->nextSibling != nullptr) last->nextSibling->previous = newNode;
-                    newNode->hasParent = last->hasParent;
-                    newNode->previous = last->previous;
-                    newNode->firstChild = last;
-                    newNode->nextSibling = last->nextSibling;
-                    last->hasParent = true;
-                    last->previous = newNode;
-                    last->nextSibling = nullptr;
-                    lastlast = newNode;
-                    // Make cToken an argument list and carry on
-                    cToken = Token(Token::TokenType::ARGUMENT_LIST, cToken.getValue(), cToken.getLine(), cToken.getPos());
-                }
+    // The old records up to the kept one are swapped for the ones made, the kept one's too since the state before it changed,
+            // it still counts the same as it did
+    if (kept < statements.size()) recordStatements(restart, kept + 1 - restart, {statements.getCount(kept, TOKENS), statements.getCount(kept, BYTES)});
+    else recordStatements(restart, statements.size() - restart, {count - made.back().before.tokens, 0});
+    record->tokens = count;
+    // Whatever is left of the old statements was built again
+    release(cut);
+    return true;
+}
+
+// The one edit that does the same as this one followed by next, so edits can be saved up between builds
+IntermediateNode::TokenEdit IntermediateNode::TokenEdit::then(const TokenEdit &next) const {
+    // Where this edit's new tokens end once next has been made, a position inside what next replaced ends up at the end of it
+    uint32_t end = first + added;
+    if (end >= next.first + next.removed) end = end - next.removed + next.added;
+    else if (end > next.first) end = next.first + next.added;
+    // Where next's old tokens end before this edit was made, in the same way
+    uint32_t oldEnd = next.first + next.removed;
+    if (oldEnd >= first + added) oldEnd = oldEnd - added + removed;
+    else if (oldEnd > first) oldEnd = first + removed;
+
+    uint32_t start = std::min(first, next.first);
+    end = std::max(end, next.first + next.added);
+    oldEnd = std::max(oldEnd, first + removed);
+    return {start, oldEnd - start, end - start, offsetShift + next.offsetShift};
+}
+
+IntermediateNode::BuildTarget IntermediateNode::rootTarget() {
+    if (arena == nullptr) arena = std::make_unique<NodeArena>();
+    return {arena.get(), &record->made, this};
+}
+
+void IntermediateNode::beginBuild() {
+    if (token.getType() != Token::TokenType::UNSET) destroy();
+    if (record == nullptr) record = std::make_unique<BuildRecord>();
+    record->statements.clear();
+    record->made.clear();
+    record->tokens = 0;
+}
+
+void IntermediateNode::endBuild(const BuildState &state) {
+    record->origin = record->made.empty() ? 0 : record->made.front().offset;
+    record->tokens = state.tokens;
+    recordStatements(0, 0, {record->made.empty() ? 0 : state.tokens - record->made.back().before.tokens, 0});
+}
+
+bool IntermediateNode::isStopped(uint32_t &countdown) {
+    if (--countdown != 0) return false;
+    countdown = stopInterval;
+    return record->stop && record->stop();
+}
+
+void IntermediateNode::abandonBuild() {
+    record->statements.clear();
+    record->made.clear();
+    record->tokens = 0;
+}
+
+void IntermediateNode::recordStatements(size_t at, size_t removed, const StatementCounts &last) {
+    std::vector<Statement> &made = record->made;
+    std::vector<StatementCounts> counts(made.size());
+    for (size_t i = 0; i + 1 < made.size(); ++i)
+        counts[i] = {made[i + 1].before.tokens - made[i].before.tokens, made[i + 1].offset - made[i].offset, 0};
+    if (!made.empty()) counts.back() = {last[TOKENS], last[BYTES], 0};
+    for (size_t i = 0; i < made.size(); ++i) {
+        // Its nodes' offsets are already counted from its start, so the errors are too and stay right wherever it moves
+        IntermediateNode *top = made[i].node;
+        while (top->parent != nullptr) top = top->parent;
+        std::vector<SyntaxError> &errors = made[i].errors;
+        errors.clear();
+        for (IntermediateNode *node = top; node != nullptr && (node == top || node->parent != nullptr); node = node->getNextInPreOrder(nullptr))
+            checkNode(node->token, node->childCount, node->lastChild != nullptr ? &node->lastChild->token : nullptr, errors);
+        // The walk visits an operator before the operand on its left, so it is only nearly in order
+        std::stable_sort(errors.begin(), errors.end());
+        counts[i][ERRORS] = errors.size();
+    }
+    record->statements.erase(at, removed);
+    record->statements.insert(at, std::move(made), counts);
+    made.clear();
+}
+
+uint32_t IntermediateNode::getStatementOffset(size_t statement) {
+    if (record == nullptr || statement >= record->statements.size()) return 0;
+    return record->origin + (uint32_t)record->statements.getBefore(statement, BYTES);
+}
+
+IntermediateNode::TokenText IntermediateNode::textAt(std::string_view source, const std::vector<LexToken> &tokens, size_t index) {
+    if (index >= tokens.size()) return {{}, 0};
+    return {tokens[index].text(source), tokens[index].offset};
+}
+
+// A bracket that has been matched, it is a whole value whatever is inside it
+static bool isClosedBracket(const Token &t) {
+    return (t.getSymbol() == Symbol::PARENS || t.getSymbol() == Symbol::SQUARES) &&
+            (t.getType() == Token::TokenType::UNARY_OPERATOR || t.getType() == Token::TokenType::ARGUMENT_LIST ||
+            t.getType() == Token::TokenType::LIST_LITERAL);
+}
+
+// Adds the next token onto the tree being built, all of the building state is in state so tokens can be fed in from anywhere
+void IntermediateNode::addToken(TokenText text, TokenText next, BuildState &state, const BuildTarget &target) {
+    IntermediateNode *&lastTopLevel = state.lastTopLevel;
+    IntermediateNode *&last = state.last;
+    const BuildState before = state;
+    ++state.tokens;
+    bool first = true, inLink = false, inHtml = false;
+    if (last != nullptr) {
+        if (last->token.getType() == Token::TokenType::KEYWORD &&
+                (last->token.getSymbol() == Symbol::OPEN ||
+                last->token.getSymbol() == Symbol::FILE))
+            inLink = true;
+        else if (last->getParent() != nullptr &&
+                (last->getParent()->token.getType() == Token::TokenType::FILE_LITERAL ||
+                (last->getParent()->token.getType() == Token::TokenType::KEYWORD &&
+                (last->getParent()->token.getSymbol() == Symbol::OPEN ||
+                last->getParent()->token.getSymbol() == Symbol::FILE))))
+            inLink = true;
+        // Only a closed bracket or a complete leaf like a name or literal finishes a value, after anything else
+                // an operand is expected, which is what makes a '+' or '-' unary
+        first = !(isClosedBracket(last->token) ||
+                (Token::getPhraseLength(last->token) == 0 && last->token.getType() != Token::TokenType::FILLER));
+        if (last->token.getType() == Token::TokenType::KEYWORD &&
+                last->token.getSymbol() == Symbol::CREATE)
+            inHtml = true;
+    }
+    Token cToken = Token(Token::getLiteral(text.text, inLink), text.text, text.offset, first, inLink, inHtml);
+
+    // '/' merges with file literals
+    if (last != nullptr && cToken.getType() == Token::TokenType::BINARY_OPERATOR && cToken.getSymbol() == Symbol::SLASH &&
+            last->token.getType() == Token::TokenType::FILE_LITERAL) {
+        last->token.setValue(std::string(last->token.getValue()) + "/");
+        return; // Merging so not creating a new token
+    }
+
+    // Two character operators come in as two tokens, the second is used up here so the operator is made whole
+    if (Symbol compound = Token::getCompound(cToken, next.text); compound != Symbol::EMPTY) {
+        cToken = Token(Token::TokenType::BINARY_OPERATOR, compound, cToken.getOffset(),
+                next.offset + (uint32_t)next.text.size() - cToken.getOffset());
+        ++state.tokens;
+    }
+    // Kept from the start of the statement, moved on to its own start below if it starts the next one
+    cToken.setOffset(cToken.getOffset() - state.base);
+
+    // The first token is always special, it just becomes the first token
+    if (last == nullptr) {
+        last = target.first;
+        lastTopLevel = target.first;
+        state.base = text.offset;
+        cToken.setOffset(0);
+        last->token = cToken;
+        target.statements->push_back({before, last, state.base, {}});
+        return;
+    }
+
+    // If the last element is not part of a const or argument list automatically assume equality
+    if (cToken.getType() == Token::TokenType::ASSIGNMENT &&
+            (last->getParent() == nullptr ||
+            (last->getParent()->token.getType() != Token::TokenType::CONST &&
+            last->getParent()->token.getType() != Token::TokenType::ARGUMENT_LIST)))
+        cToken = Token(Token::TokenType::BINARY_OPERATOR, Symbol::ASSIGN, // This does mean there is both a "=" and "==" binary operator that function the same, but if I were to make this == you wouldn't be able to explicitly type "==" for the binary equality
+                cToken.getOffset(), cToken.getLength());
+
+    // Assignments and binary operators come after their left operand, so they take it from the tree
+            // and have everything else added to them from then on
+    if (cToken.getType() == Token::TokenType::ASSIGNMENT || cToken.getType() == Token::TokenType::BINARY_OPERATOR) {
+        IntermediateNode *newNode = target.arena->make();
+        newNode->token = cToken;
+        last->findOperand(cToken)->wrapWith(newNode);
+        last = newNode;
+        return;
+    }
+
+    // Unary Operators, only the unary '/' (only meant to be used for starting a file literal)
+            // and the unary '(' since it might be an argument list '(' are special
+    if (cToken.getType() == Token::TokenType::UNARY_OPERATOR) {
+        // A unary '/' just makes a blank file literal, allowing you to make one at any point if you so wanted, though again it is just a string its not typed
+                // just has some extra features in that you can be warned if it's not found, and it can be placed in subdirectories and still be found
+        if (cToken.getSymbol() == Symbol::SLASH)
+            cToken = Token(Token::TokenType::FILE_LITERAL, Symbol::EMPTY, cToken.getOffset(), cToken.getLength());
+        else if (cToken.getSymbol() == Symbol::OPEN_PAREN) {
+            // Make argument expression if possible, since it only replaces a value expression or an htmlpart it will always be acceptable so no need to check
+            const Token call = Token(Token::TokenType::BINARY_OPERATOR, cToken.getSymbol(), cToken.getOffset());
+            IntermediateNode *callee = last->findOperand(call);
+            if (callee->token.getType() == Token::TokenType::HTMLPART ||
+                    (Token::isValueExpression(callee->token) &&
+                    callee->isComplete())) {
+                // Make a binary '(' around what is being called
+                IntermediateNode *newNode = target.arena->make();
+                newNode->token = call;
+                callee->wrapWith(newNode);
+                last = newNode;
+                // Make cToken an argument list and carry on
+                cToken = Token(Token::TokenType::ARGUMENT_LIST, cToken.getSymbol(), cToken.getOffset());
             }
         }
+    }
 
-        // File literals, only thing special is to merge with previous ones if there are any
-        else if (cToken.getType() == Token::TokenType::FILE_LITERAL) {
-            if (last->token.getType() == Token::TokenType::FILE_LITERAL) {
-                if ((last->token.getValue().size() == 0 || last->token.getValue().back() == '/') ||
-                        (cToken.getValue().size() == 0 || cToken.getValue().front() == '/'))
-                    last->token.setValue(last->token.getValue() + cToken.getValue());
-                    // If neither literal has a '/' and neither is blank then add a slash when conjoining
-                else last->token.setValue(last->token.getValue() + "/" + cToken.getValue());
-                continue; // Merging so not creating a new token
-            }
+    // File literals, only thing special is to merge with previous ones if there are any
+    else if (cToken.getType() == Token::TokenType::FILE_LITERAL) {
+        if (last->token.getType() == Token::TokenType::FILE_LITERAL) {
+            std::string path(last->token.getValue());
+            std::string_view next = cToken.getValue();
+            // If neither literal has a '/' and neither is blank then add a slash when conjoining
+            if (!(path.size() == 0 || path.back() == '/') && !(next.size() == 0 || next.front() == '/'))
+                path += '/';
+            last->token.setValue(path + std::string(next));
+            return; // Merging so not creating a new token
         }
+    }
 
-        // Filler, closing brackets are special, remember we don't know which type of ')' we have (either unary or argument list, the binary one doesn't need closing cause its paired with argument list)
-        else if (cToken.getType() == Token::TokenType::FILLER) {
-            std::string match = "";
-            if (cToken.getValue() == ")") match = "(";
-            else if (cToken.getValue() == "]") match = "[";
-            if (match != "") {
-                IntermediateNode *lastp = last;
-                // Do not match with a binary '(', only matching with unary '(', arg list '(', or list literal '['
-                // Binary '(' will never need matching
-                // To avoid string literals and others we explicitly type unary, arg list, or list literal.
-                while (!(lastp->token.getValue() == match && (lastp->token.getType() == Token::TokenType::UNARY_OPERATOR || 
-                        lastp->token.getType() == Token::TokenType::ARGUMENT_LIST || lastp->token.getType() == Token::TokenType::LIST_LITERAL))) {
-                    lastp = lastp->getParent();
-                    if (lastp == nullptr) break; // Will go on to add it as a literal and cause a syntax error for a mismatched bracket.
-                }
-                // If we are here we have thus found the matching bracket and can close it and then continue
-                lastp->token.setValue(match + cToken.getValue());
-                // If it is not a unary operator then is some kind of list and we remove any potential trailing comma child
-                if (lastp->token.getType() != Token::TokenType::UNARY_OPERATOR) {
-                    if (auto *lc = (*lastp)[-1]; lc != nullptr && lc->token.getValue() == "," && lc->token.getType() == Token::TokenType::FILLER) {
-                        lc->disconnect();
-                        // Since it has a parent we can safely call disconnect(), a comma literal should never have a child, and we got it by it being the last child, so it shouldn't have any children or siblings anyway, but to be safe calling disconnect to avoid deleting them
-                        delete lc;
-                    }
-                }
-                continue;
+    // Filler, closing brackets are special, remember we don't know which type of ')' we have (either unary or argument list, the binary one doesn't need closing cause its paired with argument list)
+    else if (cToken.getType() == Token::TokenType::FILLER) {
+        Symbol match = Symbol::EMPTY, closed = Symbol::EMPTY;
+        if (cToken.getSymbol() == Symbol::CLOSE_PAREN) {
+            match = Symbol::OPEN_PAREN;
+            closed = Symbol::PARENS;
+        } else if (cToken.getSymbol() == Symbol::CLOSE_SQUARE) {
+            match = Symbol::OPEN_SQUARE;
+            closed = Symbol::SQUARES;
+        }
+        IntermediateNode *lastp = nullptr;
+        if (match != Symbol::EMPTY) {
+            lastp = last;
+            // Do not match with a binary '(', only matching with unary '(', arg list '(', or list literal '['
+            // Binary '(' will never need matching
+            // To avoid string literals and others we explicitly type unary, arg list, or list literal.
+            while (!(lastp->token.getSymbol() == match && (lastp->token.getType() == Token::TokenType::UNARY_OPERATOR || 
+                    lastp->token.getType() == Token::TokenType::ARGUMENT_LIST || lastp->token.getType() == Token::TokenType::LIST_LITERAL))) {
+                lastp = lastp->getParent();
+                if (lastp == nullptr) break; // Will go on to add it as a literal and cause a syntax error for a mismatched bracket.
             }
         }
-
-        // Add as child as last if it needs and can be added, if not keep going to the parent up
-        IntermediateNode *lastp = last;
-        while (lastp != nullptr) {
-            if (!lastp->isComplete() && Token::doesAcceptInPosition(lastp->token, cToken, lastp->getNumberChildren(), false)) {
-                // Make and add as a child
-                IntermediateNode *node = new IntermediateNode();
-                node->token = cToken;
-                lastp->addChild(node);
-                lastlast = last;
-                last = node;
-                // Argument lists and regular lists need an initial ',' filler as a first child
-                if (cToken.getType() == Token::TokenType::ARGUMENT_LIST || cToken.getType() == Token::TokenType::LIST_LITERAL) {
-                    IntermediateNode *node2 = new IntermediateNode();
-                    node2->token = Token(Token::TokenType::FILLER, ",", cToken.getLine(), cToken.getPos());
-                    last->addChild(node2);
-                    lastlast = last;
-                    last = node2;
+        // Without a match it carries on below like any other token and stays in the tree as a stray bracket
+        if (lastp != nullptr) {
+            // If we are here we have thus found the matching bracket and can close it and then continue
+            lastp->token.setValue(closed);
+            // If it is not a unary operator then is some kind of list and we remove any potential trailing comma child
+            if (lastp->token.getType() != Token::TokenType::UNARY_OPERATOR) {
+                if (auto *lc = (*lastp)[-1]; lc != nullptr && lc->token.getSymbol() == Symbol::COMMA && lc->token.getType() == Token::TokenType::FILLER) {
+                    lc->disconnect();
+                    // Since it has a parent we can safely call disconnect(), a comma literal should never have a child, and we got it by it being the last child, so it shouldn't have any children or siblings anyway, but to be safe calling disconnect to avoid deleting them
+                    target.arena->release(lc);
                 }
-                break;
             }
-            lastp = lastp->getParent();
+            // Carry on from the bracket, anything after it follows the whole of it
+            last = lastp;
+            return;
         }
+    }
 
-        // If you couldn't find any then make a sibling of the lasttoplevel
-        // This is also the only time we update lastTopLevel
-        if (lastp == nullptr) {
-            IntermediateNode *node = new IntermediateNode();
+    // Add as child as last if it needs and can be added, if not keep going to the parent up
+            // last is at the end of every one of its ancestors' last children, so each one's completeness only needs its own
+            // children and the answer from the one below, every node climbed past is left behind for good so the climbs add up to
+            // no more than the tree, however broken the input is
+    IntermediateNode *lastp = last;
+    bool complete = last->isComplete();
+    while (lastp != nullptr) {
+        if (!complete && Token::doesAcceptInPosition(lastp->token, cToken, lastp->getNumberChildren(), false)) {
+            // Make and add as a child
+            IntermediateNode *node = target.arena->make();
             node->token = cToken;
-            lastTopLevel->addSibling(node);
-            lastlast = last;
+            lastp->addChild(node);
             last = node;
-            lastTopLevel = node;
+            // Argument lists and regular lists need an initial ',' filler as a first child
+            if (cToken.getType() == Token::TokenType::ARGUMENT_LIST || cToken.getType() == Token::TokenType::LIST_LITERAL) {
+                IntermediateNode *node2 = target.arena->make();
+                node2->token = Token(Token::TokenType::FILLER, Symbol::COMMA, cToken.getOffset());
+                last->addChild(node2);
+                last = node2;
+            }
+            break;
         }
+        IntermediateNode *below = lastp;
+        lastp = lastp->getParent();
+        if (lastp == nullptr) break;
+        const Completion own = lastp->getOwnCompletion();
+        if (own != Completion::LAST_CHILD) complete = own == Completion::DONE;
+        else if (lastp->lastChild != below) complete = lastp->isComplete();
     }
+
+    // If you couldn't find any then make a sibling of the lasttoplevel, nothing open takes it so it is where the next statement starts
+    // This is also the only time we update lastTopLevel
+    if (lastp == nullptr) {
+        // An operator can have since wrapped the last statement, the new one goes after all of it rather than inside it
+        while (lastTopLevel->parent != nullptr) lastTopLevel = lastTopLevel->parent;
+        IntermediateNode *node = target.arena->make();
+        state.base += cToken.getOffset();
+        cToken.setOffset(0);
+        node->token = cToken;
+        lastTopLevel->addSibling(node);
+        last = node;
+        lastTopLevel = node;
+        if (node->parent == nullptr) target.statements->push_back({before, node, state.base, {}});
+    }
+}
+
+IntermediateNode * IntermediateNode::findOperand(Token op) {
+    const uint8_t precedence = Token::getPrecedence(op);
+    IntermediateNode *operand = this;
+    // Only operators with all their operands can be climbed past, everything else is still waiting on this one
+    while (operand->parent != nullptr) {
+        const Token above = operand->parent->token;
+        if ((above.getType() != Token::TokenType::BINARY_OPERATOR && above.getType() != Token::TokenType::UNARY_OPERATOR) ||
+                operand->parent->childCount < Token::getPhraseLength(above))
+            break;
+        const uint8_t held = Token::getPrecedence(above);
+        if (held < precedence || (held == precedence && Token::isRightAssociative(op))) break;
+        operand = operand->parent;
+    }
+    return operand;
+}
+
+void IntermediateNode::checkNode(Token t, uint32_t children, const Token *lastChild, std::vector<SyntaxError> &errors) {
+    const Symbol value = t.getSymbol();
+    auto report = [&](SyntaxError::SyntaxErrorType type) {
+        errors.emplace_back(type, t.getOffset(), std::max<uint32_t>(t.getLength(), 1));
+    };
+    switch (t.getType()) {
+        case Token::TokenType::UNKNOWN:
+            report(SyntaxError::SyntaxErrorType::UnknownToken);
+            return;
+        case Token::TokenType::FILLER:
+            // A closing bracket only stays in the tree when nothing was open for it
+            if (value == Symbol::CLOSE_PAREN || value == Symbol::CLOSE_SQUARE) report(SyntaxError::SyntaxErrorType::UnmatchedBracket);
+            return;
+        case Token::TokenType::UNARY_OPERATOR:
+        case Token::TokenType::ARGUMENT_LIST:
+        case Token::TokenType::LIST_LITERAL:
+            // Closing a bracket adds it on to the value, the binary '(' of a call is never closed itself
+            if (value == Symbol::OPEN_PAREN || value == Symbol::OPEN_SQUARE) {
+                report(SyntaxError::SyntaxErrorType::UnmatchedBracket);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    // Only this node's own children are checked, anything incomplete below it gets its own error
+    uint32_t target = Token::getPhraseLength(t);
+    if (target == (uint32_t)-1) {
+        if (t.getType() == Token::TokenType::ARGUMENT_LIST && lastChild != nullptr &&
+                lastChild->getType() == Token::TokenType::NAME)
+            report(SyntaxError::SyntaxErrorType::IncompletePhrase);
+    } else if (children < target) report(SyntaxError::SyntaxErrorType::IncompletePhrase);
 }
 
 // Goes through the tree and compiles a list of errors so that the editor window can
 // squiggle and so that it can be displayed as a list of text in a popup.
-std::vector<SyntaxError> getErrors() {
-    throw NotImplementedException();
+// One walk over every node, each is only checked against its own children, then sorted by position.
+std::vector<SyntaxError> IntermediateNode::getErrors() {
+    std::vector<SyntaxError> errors;
+    if (token.getType() == Token::TokenType::UNSET || record == nullptr) return errors;
+    // Only the statements that have any are looked at, each one's are in order and so are the statements
+    const ChunkedList<Statement, 3> &statements = record->statements;
+    const uint64_t total = statements.getTotal(ERRORS);
+    errors.reserve(total);
+    while (errors.size() < total) {
+        const size_t statement = statements.find(errors.size(), ERRORS);
+        const uint32_t base = getStatementOffset(statement);
+        for (const SyntaxError &error : statements[statement].errors)
+            errors.emplace_back(error.getType(), base + error.getOffset(), error.getLength());
+    }
+    return errors;
 }
 
 bool IntermediateNode::isComplete() {
+    // Only the last child of a phrase can still be open, so follow that chain down instead of recursing
+    for (IntermediateNode *node = this; ; node = node->lastChild) {
+        const Completion own = node->getOwnCompletion();
+        if (own != Completion::LAST_CHILD) return own == Completion::DONE;
+    }
+}
+
+IntermediateNode::Completion IntermediateNode::getOwnCompletion() {
     uint32_t target = Token::getPhraseLength(token);
-    uint32_t children = getNumberChildren();
-    IntermediateNode *child = getChild(-1);
     if (target == (uint32_t)-1) {
-        if (children == 0) return true; // No comma means it has been removed and you are done, just happens to be empty
+        if (childCount == 0) return Completion::DONE; // No comma means it has been removed and you are done, just happens to be empty
         // For argument lists if the last child is a name then incomplete
-        if (child->token.getType() == Token::TokenType::NAME &&
-                token.getType() == Token::TokenType::ARGUMENT_LIST) return false;
+        if (lastChild->token.getType() == Token::TokenType::NAME &&
+                token.getType() == Token::TokenType::ARGUMENT_LIST) return Completion::OPEN;
         // If the value is either just a '(' or just a '[' it has not been matched with a closing bracket and so is not complete
-        if (token.getValue() == "(" || token.getValue() == "[") return false;
-        // Recursiveness
-        return child->isComplete();
+        if (token.getSymbol() == Symbol::OPEN_PAREN || token.getSymbol() == Symbol::OPEN_SQUARE) return Completion::OPEN;
+        return Completion::LAST_CHILD;
     }
-    if (target > getNumberChildren()) return false;
+    if (target > childCount) return Completion::OPEN;
     // More children would be incorrect too, but it is complete, so that would be a separate validation to check for that
     // Finally make sure the last child if applicable is complete
-    if (children == 0) return true;
-    return child->isComplete();
+    if (childCount == 0) return Completion::DONE;
+    return Completion::LAST_CHILD;
 }
 
 void IntermediateNode::addSibling(IntermediateNode* node) {
-    if (nextSibling != nullptr) nextSibling->addSibling(node);
+    // With a parent the end of the sibling chain is its last child
+    if (parent != nullptr) parent->addChild(node);
     else {
-        nextSibling = node;
-        node->hasParent = false;
-        node->previous = this;
+        IntermediateNode *youngest = this;
+        while (youngest->nextSibling != nullptr) youngest = youngest->nextSibling;
+        youngest->nextSibling = node;
+        node->parent = nullptr;
+        node->prevSibling = youngest;
     }
 }
 
 void IntermediateNode::addChild(IntermediateNode* node) {
-    if (firstChild != nullptr) firstChild->addSibling(node);
-    else {
-        firstChild = node;
-        node->hasParent = true;
-        node->previous = this;
-    }
+    node->parent = this;
+    node->prevSibling = lastChild;
+    node->nextSibling = nullptr;
+    if (lastChild != nullptr) lastChild->nextSibling = node;
+    else firstChild = node;
+    lastChild = node;
+    ++childCount;
+}
+
+Token IntermediateNode::getToken() {
+    return token;
 }
 
 IntermediateNode * IntermediateNode::getParent() {
-    if (previous == nullptr) return nullptr;
-    if (hasParent) return previous;
-    return previous->getParent();
+    return parent;
 }
 
 
 // Negative indices the size gets added, gives nullptr for anything too negative or too positive that it exceeds
 IntermediateNode * IntermediateNode::getChild(int32_t index) {
     if (index < 0) {
-        index += getNumberChildren();
+        index += childCount;
         if (index < 0) return nullptr;
     }
     if (index == 0) return firstChild;
+    if ((uint32_t)index + 1 == childCount) return lastChild;
     if (firstChild == nullptr) return nullptr;
     return firstChild->getSibling(index-1);
 }
@@ -361,107 +691,164 @@ IntermediateNode * IntermediateNode::getChild(int32_t index) {
 // Returns nullptr for negatives or if the index is too high
 IntermediateNode * IntermediateNode::getSibling(int32_t index) {
     if (index < 0) return nullptr;
-    if (index == 0) return nextSibling;
-    if (nextSibling == nullptr) return nullptr;
-    return nextSibling->getSibling(index-1);
+    IntermediateNode *sibling = nextSibling;
+    for (; sibling != nullptr && index > 0; --index) sibling = sibling->nextSibling;
+    return sibling;
 }
 
 uint32_t IntermediateNode::getNumberChildren() {
-    if (firstChild == nullptr) return 0;
-    return 1 + firstChild->getNumberYoungerSiblings();
+    return childCount;
 }
 
 uint32_t IntermediateNode::getNumberYoungerSiblings() {
-    if (nextSibling == nullptr) return 0;
-    return 1 + nextSibling->getNumberYoungerSiblings();
+    uint32_t num = 0;
+    for (IntermediateNode *sibling = nextSibling; sibling != nullptr; sibling = sibling->nextSibling) ++num;
+    return num;
 }
 
+// Counts this, its younger siblings and everything below them
 uint32_t IntermediateNode::getNumberTotal() {
-    uint32_t num = 1;
-    if (firstChild != nullptr) num += firstChild->getNumberTotal();
-    if (nextSibling != nullptr) num += nextSibling->getNumberTotal();
+    uint32_t num = 0;
+    for (IntermediateNode *node = this; node != nullptr; node = node->getNextInPreOrder(parent)) ++num;
     return num;
 }
 
-#ifdef DEBUG
-void IntermediateNode::getAsVector(std::vector<std::string> &vec) {
-    // Add string for this one
-    std::string str;
-    switch (token.getType()) {
-        case Token::TokenType::CONST:
-            str = "c: ";
-            break;
-        case Token::TokenType::KEYWORD:
-            str = "kw: ";
-            break;
-        case Token::TokenType::FILLER:
-            str = "f: ";
-            break;
-        case Token::TokenType::NAME:
-            str = "n: ";
-            break;
-        case Token::TokenType::HTMLPART:
-            str = "html: ";
-            break;
-        case Token::TokenType::STRING_LITERAL:
-            str = "\"\": ";
-            break;
-        case Token::TokenType::BOOL_LITERAL:
-            str = "b: ";
-            break;
-        case Token::TokenType::NUMERIC_LITERAL:
-            str = "num: ";
-            break;
-        case Token::TokenType::THIS_LITERAL:
-            str = "t: ";
-            break;
-        case Token::TokenType::FILE_LITERAL:
-            str = "/: ";
-            break;
-        case Token::TokenType::COLOR_LITERAL:
-            str = "#: ";
-            break;
-        case Token::TokenType::LIST_LITERAL:
-            str = "l: ";
-            break;
-        case Token::TokenType::ARGUMENT_LIST:
-            str = "al: ";
-            break;
-        case Token::TokenType::UNARY_OPERATOR:
-            str = "1: ";
-            break;
-        case Token::TokenType::BINARY_OPERATOR:
-            str = "2: ";
-            break;
-        case Token::TokenType::ASSIGNMENT:
-            str = "=: ";
-            break;
-        default:
-            str = "?: ";
-            break;
+uint32_t IntermediateNode::getNodeCount() {
+    // The root is the one node not from the arena
+    if (token.getType() == Token::TokenType::UNSET || arena == nullptr) return 0;
+    return 1 + (uint32_t)arena->size();
+}
+
+// Walks down to the first child, otherwise along to the next sibling, otherwise back up until an ancestor has one,
+        // so any depth is walked without recursion. Gives nullptr instead of climbing back up to stop.
+IntermediateNode * IntermediateNode::getNextInPreOrder(const IntermediateNode *stop) {
+    if (firstChild != nullptr) return firstChild;
+    IntermediateNode *node = this;
+    while (node->nextSibling == nullptr) {
+        node = node->parent;
+        if (node == stop || node == nullptr) return nullptr;
     }
-    str += token.getValue();
-    str += " (" + std::to_string(getNumberChildren()) + ")";
-    vec.push_back(str);
-
-    // Get binary tree children vectors
-    std::vector<std::string> vecLeft;
-    std::vector<std::string> vecRight;
-    if (firstChild != nullptr) firstChild->getAsVector(vecLeft);
-    if (nextSibling != nullptr) nextSibling->getAsVector(vecRight);
-
-    // Merge them together into the main vector filling in blanks to preserve order
-    uint32_t vls = vecLeft.size(), vrs = vecRight.size();
-    uint32_t max = vls > vrs ? vls : vrs;
-    for (size_t i = 0; pow(2, i) <= max; ++i) {
-        for (size_t j = pow(2, i)-1; j < pow(2, i+1)-1; ++j)
-            vec.push_back(j < vls ? vecLeft[j] : "");
-        for (size_t j = pow(2, i)-1; j < pow(2, i+1)-1; ++j)
-            vec.push_back(j < vrs ? vecRight[j] : "");
+    return node->nextSibling;
+}
+
+#ifdef DEBUG
+// Binary tree layout: a node at index i has its first child at 2i+1 and its next sibling at 2i+2, gaps are blank
+// Filled in level by level so that long sibling chains and deep nesting do not recurse
+void IntermediateNode::getAsVector(std::vector<std::string> &vec, std::string_view source) {
+    // Offsets are counted from the statement's start, each node carries which top level statement it is in
+    auto label = [&](IntermediateNode *node, size_t statement) {
+        std::string str;
+        switch (node->token.getType()) {
+            case Token::TokenType::CONST:
+                str = "c: ";
+                break;
+            case Token::TokenType::KEYWORD:
+                str = "kw: ";
+                break;
+            case Token::TokenType::FILLER:
+                str = "f: ";
+                break;
+            case Token::TokenType::NAME:
+                str = "n: ";
+                break;
+            case Token::TokenType::HTMLPART:
+                str = "html: ";
+                break;
+            case Token::TokenType::STRING_LITERAL:
+                str = "\"\": ";
+                break;
+            case Token::TokenType::BOOL_LITERAL:
+                str = "b: ";
+                break;
+            case Token::TokenType::NUMERIC_LITERAL:
+                str = "num: ";
+                break;
+            case Token::TokenType::THIS_LITERAL:
+                str = "t: ";
+                break;
+            case Token::TokenType::FILE_LITERAL:
+                str = "/: ";
+                break;
+            case Token::TokenType::COLOR_LITERAL:
+                str = "#: ";
+                break;
+            case Token::TokenType::LIST_LITERAL:
+                str = "l: ";
+                break;
+            case Token::TokenType::ARGUMENT_LIST:
+                str = "al: ";
+                break;
+            case Token::TokenType::UNARY_OPERATOR:
+                str = "1: ";
+                break;
+            case Token::TokenType::BINARY_OPERATOR:
+                str = "2: ";
+                break;
+            case Token::TokenType::ASSIGNMENT:
+                str = "=: ";
+                break;
+            default:
+                str = "?: ";
+                break;
+        }
+        const uint64_t offset = (uint64_t)getStatementOffset(statement) + node->token.getOffset();
+        str += node->token.getValueText(offset < source.size() ? source.substr(offset, node->token.getLength()) : std::string_view());
+        str += " (" + std::to_string(node->getNumberChildren()) + ")";
+        return str;
+    };
+
+    // Each level takes twice the room of the one above, and a sibling chain goes down a level per sibling, so anything past
+            // this deep is cut off and the nodes it was cut from are marked with "..."
+    constexpr size_t maxDepth = 16;
+    struct Placed {
+        IntermediateNode *node;
+        size_t index, statement;
+    };
+    // The root can end up below an operator, so start from the top
+    IntermediateNode *top = this;
+    while (top->parent != nullptr) top = top->parent;
+    std::vector<Placed> level = {{top, 0, 0}}, nextLevel;
+    std::vector<std::pair<size_t, std::string>> labels;
+    size_t depth = 0;
+    for (; !level.empty(); ++depth) {
+        nextLevel.clear();
+        const bool last = depth + 1 == maxDepth;
+        for (auto [node, index, statement] : level) {
+            std::string text = label(node, statement);
+            if (last && (node->firstChild != nullptr || node->nextSibling != nullptr)) text += " ...";
+            labels.emplace_back(index, std::move(text));
+            if (last) continue;
+            if (node->firstChild != nullptr) nextLevel.push_back({node->firstChild, index * 2 + 1, statement});
+            if (node->nextSibling != nullptr) nextLevel.push_back({node->nextSibling, index * 2 + 2, statement + (node->parent == nullptr)});
+        }
+        level.swap(nextLevel);
     }
+
+    // Every level down to the deepest is filled in, blanks included, to preserve order
+    size_t base = vec.size();
+    vec.resize(base + ((size_t)1 << depth) - 1);
+    for (auto &[index, str] : labels) vec[base + index] = std::move(str);
 }
 #endif
 
+// Whether both trees have the same nodes in the same places, for checking other ways of building one
+bool IntermediateNode::isSameTree(IntermediateNode *other) {
+    IntermediateNode *a = this, *b = other;
+    while (a->parent != nullptr) a = a->parent;
+    while (b->parent != nullptr) b = b->parent;
+    size_t statement = 0;
+    for (; a != nullptr && b != nullptr; a = a->getNextInPreOrder(nullptr), b = b->getNextInPreOrder(nullptr)) {
+        // Offsets within a statement only match if the statements start in the same place
+        if (a->parent == nullptr && getStatementOffset(statement) != other->getStatementOffset(statement)) return false;
+        statement += a->parent == nullptr;
+        if (a->token.getType() != b->token.getType() || !a->token.hasSameValue(b->token) ||
+                a->token.getOffset() != b->token.getOffset() ||
+                a->token.getLength() != b->token.getLength() || a->childCount != b->childCount)
+            return false;
+    }
+    return a == nullptr && b == nullptr;
+}
+
 // Just calls getChild(), look there for details
 IntermediateNode * IntermediateNode::operator[](int32_t index) {
     return getChild(index);
@@ -471,81 +858,89 @@ IntermediateNode::~IntermediateNode() {
     destroy();
 }
 
+// Gives the node back to the root's arena along with its subtree and younger siblings
+void IntermediateNode::release(IntermediateNode *node) {
+    // Collected first since releasing a node clears the links the walk follows
+    std::vector<IntermediateNode *> nodes;
+    const IntermediateNode *stop = node->parent;
+    for (; node != nullptr; node = node->getNextInPreOrder(stop)) nodes.push_back(node);
+    for (IntermediateNode *released : nodes) arena->release(released);
+}
+
 // Dangerous since it can leave stranded bits of the tree
 void IntermediateNode::disconnect() {
-    // If there is a previous then it won't leave anything stranded it will connect
-    if (previous != nullptr) {
-        if (hasParent) {
-            // First child replaces it
-            if (firstChild != nullptr) {
-                firstChild->previous = previous;
-                previous->firstChild = firstChild;
-                // firstChild->hasParent would already be set to true
-                // If there is a next sibling it will become a sibling of the child, still stranded though, this will likely break any syntax but if this is happening
-                        // syntax is already broken, and we are preventing memory leaks.
-                if (nextSibling != nullptr) firstChild->addSibling(nextSibling);
-            }
-            // Next sibling replaces it
-            else if (nextSibling != nullptr) {
-                nextSibling->previous = previous;
-                previous->firstChild = nextSibling;
-                nextSibling->hasParent = true;
-            }
-            // Otherwise simple disconnect
-            else previous->firstChild = nullptr;
-        } else {
-            // First child replaces it
-            if (firstChild != nullptr) {
-                firstChild->previous = previous;
-                previous->nextSibling = firstChild;
-                firstChild->hasParent = false;
-                // If there is a next sibling it will become a sibling of the child, still stranded though, this will likely break any syntax but if this is happening
-                        // syntax is already broken, and we are preventing memory leaks.
-                if (nextSibling != nullptr) firstChild->addSibling(nextSibling);
-            }
-            // Next sibling replaces it
-            else if (nextSibling != nullptr) {
-                nextSibling->previous = previous;
-                previous->nextSibling = nextSibling;
-                // nextSibling->hasParent would already be set to false
-            }
-            // Otherwise simple disconnect
-            else previous->nextSibling = nullptr;
-        }
-    }
-
-    // No parent means any children or siblings become stranded, bad!
-    else if (firstChild != nullptr) {
-        // If there is a next sibling it will become a sibling of the child, still stranded though, this will likely break any syntax but if this is happening
-                // syntax is already broken, and we are preventing memory leaks.
-        if (nextSibling != nullptr) firstChild->addSibling(nextSibling);
-        firstChild->hasParent = false;
-        firstChild->previous = nullptr;
+    if (firstChild != nullptr) {
+        // The children take its place among its siblings, this will likely break any syntax but if this is happening
+                // syntax is already broken, and we are preventing stranding them. Without a parent or older sibling they are still stranded though, bad!
+        for (IntermediateNode *child = firstChild; child != nullptr; child = child->nextSibling) child->parent = parent;
+        firstChild->prevSibling = prevSibling;
+        lastChild->nextSibling = nextSibling;
+        if (prevSibling != nullptr) prevSibling->nextSibling = firstChild;
+        else if (parent != nullptr) parent->firstChild = firstChild;
+        if (nextSibling != nullptr) nextSibling->prevSibling = lastChild;
+        else if (parent != nullptr) parent->lastChild = lastChild;
+        if (parent != nullptr) parent->childCount += childCount - 1;
     }
-
-    // Just the next sibling, which will become stranded, bad!
-    else if (nextSibling != nullptr) nextSibling->previous = nullptr;
+    // Without a parent or older sibling the younger siblings become stranded, bad!
+    else unlink();
 
     token = Token();
-    previous = nullptr;
+    parent = nullptr;
     firstChild = nullptr;
+    lastChild = nullptr;
+    prevSibling = nullptr;
+    nextSibling = nullptr;
+    childCount = 0;
+}
+
+// Takes it and its subtree out of the tree, closing the gap it leaves
+void IntermediateNode::unlink() {
+    if (prevSibling != nullptr) prevSibling->nextSibling = nextSibling;
+    else if (parent != nullptr) parent->firstChild = nextSibling;
+    if (nextSibling != nullptr) nextSibling->prevSibling = prevSibling;
+    else if (parent != nullptr) parent->lastChild = prevSibling;
+    if (parent != nullptr) --parent->childCount;
+    parent = nullptr;
+    prevSibling = nullptr;
+    nextSibling = nullptr;
+}
+
+// The childless node takes its place in the tree and it becomes that node's only child
+void IntermediateNode::wrapWith(IntermediateNode *node) {
+    node->parent = parent;
+    node->prevSibling = prevSibling;
+    node->nextSibling = nextSibling;
+    if (prevSibling != nullptr) prevSibling->nextSibling = node;
+    else if (parent != nullptr) parent->firstChild = node;
+    if (nextSibling != nullptr) nextSibling->prevSibling = node;
+    else if (parent != nullptr) parent->lastChild = node;
+    node->firstChild = this;
+    node->lastChild = this;
+    node->childCount = 1;
+    parent = node;
+    prevSibling = nullptr;
     nextSibling = nullptr;
-    hasParent = false;
 }
 
 // Deletes younger siblings and children too to prevent fragmentation and also because you often want to do that
 void IntermediateNode::destroy() {
     token = Token();
-    if (previous != nullptr) {
-        if (hasParent) previous->firstChild = nullptr;
-        else previous->nextSibling = nullptr;
-        previous = nullptr;
+    if (record != nullptr) record->statements.clear();
+    // Every other node belongs to the root's arena, on the root this frees the lot at once so there is nothing to fix up,
+            // anywhere else the cut off nodes are only reclaimed when the root is destroyed
+    if (arena != nullptr) arena->clear();
+    else {
+        if (parent != nullptr) {
+            parent->childCount -= 1 + getNumberYoungerSiblings();
+            parent->lastChild = prevSibling;
+            if (prevSibling == nullptr) parent->firstChild = nullptr;
+        }
+        if (prevSibling != nullptr) prevSibling->nextSibling = nullptr;
     }
-    hasParent = false;
-    if (firstChild != nullptr) firstChild->destroy();
-    if (nextSibling != nullptr) nextSibling->destroy();
-    delete firstChild;
-    delete nextSibling;
+    parent = nullptr;
     firstChild = nullptr;
+    lastChild = nullptr;
+    prevSibling = nullptr;
     nextSibling = nullptr;
-}
\ No newline at end of file
+    childCount = 0;
+}
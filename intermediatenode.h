@@ -8,38 +8,184 @@ PURPOSE:
 #include "defines.h"
 #include "syntaxerror.hpp"
 #include "token.hpp"
+#include "tokenparser.h"
+#include "nodearena.h"
+#include "chunkedlist.hpp"
 #include <vector>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <cstdint>
+#include <functional>
+#include <memory>
 
 class IntermediateNode {
 public:
-    void generateTree(std::vector<std::tuple<std::string, uint32_t, uint32_t>> tokens);
+    // Tokens [first, first + removed) of the last build were replaced by tokens [first, first + added),
+            // every token after them is the same apart from its offset moving by offsetShift
+    struct TokenEdit {
+        uint32_t first, removed, added;
+        int32_t offsetShift;
+
+        // The one edit that does the same as this one followed by next, so edits can be saved up between builds
+        TokenEdit then(const TokenEdit &next) const;
+    };
+    // A token's text and where it starts, the text is empty past the last token
+    struct TokenText {
+        std::string_view text;
+        uint32_t offset;
+    };
+    // Gives the token at an index, for tokens that are not all kept in one place. Its text only has to last until the token
+            // two after it is asked for, they are always asked for in order
+    using TokenLookup = std::function<TokenText(size_t index)>;
+
+    // Builds with at least this many tokens split the statements between every core
+    static constexpr size_t defaultParallelThreshold = 1 << 18;
+
+    // The tokens are spans into source, none of them are copied
+    void generateTree(std::string_view source, const std::vector<LexToken> &tokens);
+    // Lexes source as it goes, pulling tokens from a LexCursor so the tokens are never all held at once,
+            // never in parallel, for builds only read once like the compiler's
+    void generateTree(std::string_view source);
+    // For tokens that own their strings, as given by TokenParser::parse()
+    void generateTree(const std::vector<std::tuple<std::string, uint32_t>> &tokens);
+    // Same result as generateTree() but only re-parses from the top level statement the edit starts in
+            // up to the first statement after it that starts the same as before, the rest of the tree is kept as it is
+    void updateTree(std::string_view source, const std::vector<LexToken> &tokens, const TokenEdit &edit);
+    // The same but only the tokens it re-parses are looked up, gives false without touching the tree when the edit needs
+            // all of it built again, which is the only time every token is needed
+    bool updateTree(size_t count, const TokenLookup &lookup, const TokenEdit &edit);
+    // How many tokens the last build or update was made from, only on the root
+    uint32_t getTokenCount();
+    // Only on the root, 0 never builds in parallel
+    void setParallelThreshold(size_t tokens);
+    // How many pieces a parallel build splits the tokens into, 0 for one per core
+    void setThreads(unsigned threads);
+    // Asked every few thousand tokens while building, once it gives true the build stops where it is and leaves the tree
+            // unfinished, so the next update builds all of it again, only on the root
+    void setStopCheck(std::function<bool()> stop);
+    // Each statement's errors are found when it is built, so this only adds up the ones kept from last time
     std::vector<SyntaxError> getErrors();
+    // A node's token has its offset counted from where its top level statement starts, so a statement an edit moves keeps
+            // its nodes untouched, this is where the nth top level statement starts in the text, only on the root
+    uint32_t getStatementOffset(size_t statement);
+    // The errors a node has of its own from its token, how many children it has and the last of them,
+            // so FlatTree reports exactly what getErrors() does
+    static void checkNode(Token t, uint32_t children, const Token *lastChild, std::vector<SyntaxError> &errors);
     bool isComplete();
     void addSibling(IntermediateNode* node);
     void addChild(IntermediateNode* node);
     IntermediateNode * getParent();
+    Token getToken();
     // Negative indices the size gets added, gives nullptr for anything too negative or too positive that it exceeds
     IntermediateNode * getChild(int32_t index);
     uint32_t getNumberChildren();
+    // Counts this, its younger siblings and everything below them
     uint32_t getNumberTotal();
+    // The same as getNumberTotal() on the first node of a whole tree without walking it, only on the root
+    uint32_t getNodeCount();
+    // The node after this in a pre-order walk, or nullptr instead of climbing back up to stop,
+            // pass the parent of where the walk began to cover it, its younger siblings and everything below them
+    IntermediateNode * getNextInPreOrder(const IntermediateNode *stop);
     #ifdef DEBUG
-    void getAsVector(std::vector<std::string> &vec);
+    // Lays out the whole tree, only on the root, source is the text it was built from so strings and unknown tokens show
+    void getAsVector(std::vector<std::string> &vec, std::string_view source);
     #endif
+    // Whether both trees have the same nodes in the same places, for checking other ways of building one
+    bool isSameTree(IntermediateNode *other);
 
     // Just calls getChild(), look there for details
     IntermediateNode * operator[](int32_t index);
     ~IntermediateNode();
 
 private:
+    friend class NodeArena;
+    friend class FlatTree;
+
+
+    // Top level nodes have no parent and are linked through their siblings
+    IntermediateNode *parent = nullptr;
     IntermediateNode *firstChild = nullptr;
+    IntermediateNode *lastChild = nullptr;
+    IntermediateNode *prevSibling = nullptr;
     IntermediateNode *nextSibling = nullptr;
-    IntermediateNode *previous = nullptr;
+    uint32_t childCount = 0;
     Token token = Token();
-    // This is whether previous is a parent (as opposed to an older sibling or nullptr), not whether it has a parent at all,
-            // that can be checked by comparing getParent() to nullptr
-    bool hasParent = false;
+    // Only the node generateTree() was called on has one, every other node in the tree lives in it
+    std::unique_ptr<NodeArena> arena;
+
+    // Where generateTree() is adding from, kept between tokens
+    struct BuildState {
+        IntermediateNode *lastTopLevel = nullptr; // The last top level node
+        IntermediateNode *last = nullptr; // The place where we are adding from, the last node made or the bracket just closed
+        uint32_t tokens = 0; // Tokens added so far, so the index of the next one
+        uint32_t base = 0; // Where the statement being added to starts, the offsets of its nodes are counted from there
+    };
+    // A top level statement of the last build, the state before its first token is all the build needs to carry on from there
+    struct Statement {
+        BuildState before; // Its tokens and base are as the build left them, the record works out where they are now
+        IntermediateNode *node; // The node its first token made, it can since have been wrapped by an operator
+        uint32_t offset; // Where its first token starts
+        std::vector<SyntaxError> errors; // In order, with offsets from where it starts like its nodes
+    };
+    // What each recorded statement counts, the tokens and bytes up to where the next one starts
+    enum StatementCount {
+        TOKENS,
+        BYTES,
+        ERRORS
+    };
+    using StatementCounts = ChunkedList<Statement, 3>::Sizes;
+    // Only the root has one, it is what updateTree() needs to know about the last build
+    struct BuildRecord {
+        // Where a statement starts is the total of the counts before it, so statements an edit moves keep their records as they are
+        ChunkedList<Statement, 3> statements;
+        uint32_t origin = 0; // Where the first statement starts
+        std::vector<Statement> made; // What the build going on has made, put into statements once it is done
+        uint32_t tokens = 0;
+        size_t parallelThreshold = defaultParallelThreshold;
+        unsigned threads = 0;
+        std::function<bool()> stop;
+    };
+    std::unique_ptr<BuildRecord> record;
+    // Where addToken() puts what it makes, the root's own apart from the pieces of a parallel build
+    struct BuildTarget {
+        NodeArena *arena;
+        std::vector<Statement> *statements;
+        IntermediateNode *first; // Becomes the first token
+    };
+    BuildTarget rootTarget();
+    void beginBuild();
+    // Records what the build made, the last statement runs up to the last token
+    void endBuild(const BuildState &state);
+    // How many tokens go between asking the stop check
+    static constexpr uint32_t stopInterval = 4096;
+    // Whether the build should stop before adding the next token, only asks the check once countdown runs out
+    bool isStopped(uint32_t &countdown);
+    // Forgets the last build, for one that stopped partway so the next update builds all of it again
+    void abandonBuild();
+    // Puts the statements the build made in place of removed recorded ones from at, each counts up to where the one after it
+            // starts and the last one counts the tokens and bytes in last, the errors of each are found here
+    void recordStatements(size_t at, size_t removed, const StatementCounts &last);
+    // The token at index as addToken() takes it, an empty one past the last
+    static TokenText textAt(std::string_view source, const std::vector<LexToken> &tokens, size_t index);
+    // Touches nothing outside state and target, so pieces of the tree can be built on other threads,
+            // next is only looked at for two character operators and is used up when it joins this one
+    void addToken(TokenText text, TokenText next, BuildState &state, const BuildTarget &target);
+    // The node an operator coming after this one takes as its left operand, climbing past every operator
+            // above it that binds at least as tightly, so each operator is placed once where it ends up
+    IntermediateNode * findOperand(Token op);
+    // Whether a node is finished going by its own token and children, or is only finished if its last child is
+    enum class Completion : uint8_t {
+        DONE,
+        OPEN,
+        LAST_CHILD
+    };
+    Completion getOwnCompletion();
+    // Builds the same tree as adding every token in order, the statements after each split are built on their own thread
+            // as if they began the file, then kept if the token at the split starts a statement the same way in the real build
+    void generateTreeParallel(std::string_view source, const std::vector<LexToken> &tokens, unsigned pieces);
+    // Gives the node back to the root's arena along with its subtree and younger siblings
+    void release(IntermediateNode *node);
 
     // Its only purpose was to complete the getChild implementation
     // Gets sibling with relative index
@@ -49,7 +195,12 @@ private:
 
     // Dangerous since it can leave stranded bits of the tree
     void disconnect();
-    // Deletes younger siblings and children too to prevent fragmentation and also because you often want to do that
+    // Takes it and its subtree out of the tree, closing the gap it leaves
+    void unlink();
+    // The childless node takes its place in the tree and it becomes that node's only child
+    void wrapWith(IntermediateNode *node);
+    // Deletes younger siblings and children too to prevent fragmentation and also because you often want to do that,
+            // on the root that means emptying the whole arena in one go
     void destroy();
 };
 
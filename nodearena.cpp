@@ -0,0 +1,66 @@
+/* nodearena.cpp
+PURPOSE:
+- Hands out the nodes of an intermediate tree from big blocks so building a tree is a bump allocation and tearing it down is one go
+*/
+#include "nodearena.h"
+#include "intermediatenode.h"
+#include <new>
+#include <type_traits>
+
+NodeArena::~NodeArena() {
+    clear();
+    for (IntermediateNode *block : blocks) ::operator delete(block);
+}
+
+IntermediateNode * NodeArena::make() {
+    if (!released.empty()) {
+        IntermediateNode *node = released.back();
+        released.pop_back();
+        return node;
+    }
+    if (used == blockSize) {
+        blocks.push_back(static_cast<IntermediateNode *>(::operator new(sizeof(IntermediateNode) * blockSize)));
+        used = 0;
+    }
+    return new (blocks.back() + used++) IntermediateNode();
+}
+
+void NodeArena::release(IntermediateNode *node) {
+    // Reset rather than destroy, so every slot up to used always holds a live node
+    node->token = Token();
+    node->parent = nullptr;
+    node->firstChild = nullptr;
+    node->lastChild = nullptr;
+    node->prevSibling = nullptr;
+    node->nextSibling = nullptr;
+    node->childCount = 0;
+    released.push_back(node);
+}
+
+void NodeArena::adopt(std::unique_ptr<NodeArena> other) {
+    adopted.push_back(std::move(other));
+}
+
+void NodeArena::clear() {
+    // Nodes made here never own an arena themselves, so their token is all that could need tearing down,
+            // nodes are never destroyed one by one since that would walk the tree
+    if constexpr (!std::is_trivially_destructible_v<Token>) {
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            size_t count = b + 1 == blocks.size() ? used : blockSize;
+            for (size_t i = 0; i < count; ++i) blocks[b][i].token.~Token();
+        }
+    }
+    // Keep the first block around since the tree is usually rebuilt straight away
+    for (size_t b = 1; b < blocks.size(); ++b) ::operator delete(blocks[b]);
+    if (blocks.size() > 1) blocks.resize(1);
+    used = blocks.empty() ? blockSize : 0;
+    released.clear();
+    adopted.clear();
+}
+
+size_t NodeArena::size() const {
+    size_t size = blocks.empty() ? 0 : (blocks.size() - 1) * blockSize + used;
+    for (const std::unique_ptr<NodeArena> &other : adopted) size += other->size();
+    // Nodes from adopted arenas are released into this one
+    return size - released.size();
+}
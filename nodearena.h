@@ -0,0 +1,40 @@
+/* nodearena.h
+PURPOSE:
+- Hands out the nodes of an intermediate tree from big blocks so building a tree is a bump allocation and tearing it down is one go
+*/
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class IntermediateNode;
+
+class NodeArena {
+public:
+    NodeArena() = default;
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+    ~NodeArena();
+
+    // Gives a blank node, reusing released ones first
+    IntermediateNode * make();
+    // The node must already be disconnected from the tree, its memory goes to the next make()
+    void release(IntermediateNode *node);
+    // Takes over the nodes of an arena filled on another thread, they are dropped along with this one's
+    void adopt(std::unique_ptr<NodeArena> other);
+    // Drops every node at once, any pointers to them are left dangling
+    void clear();
+    // Number of nodes currently handed out
+    size_t size() const;
+
+private:
+    static constexpr size_t blockSize = 4096;
+    std::vector<IntermediateNode *> blocks; // Each holds blockSize nodes, only the last one is partly used
+    size_t used = blockSize; // Nodes used in the last block
+    std::vector<IntermediateNode *> released;
+    std::vector<std::unique_ptr<NodeArena>> adopted;
+};
+
+#endif // NODEARENA_H
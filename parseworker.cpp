@@ -0,0 +1,114 @@
+/* parseworker.cpp
+PURPOSE:
+- Keeps a parse of the open document up to date on its own thread so that compiling never holds up typing
+*/
+#include "parseworker.h"
+#include <algorithm>
+#include <chrono>
+
+ParseWorker::ParseWorker(QObject *parent) : QObject(parent), context(new QObject) {
+    qRegisterMetaType<ParseWorker::Result>();
+    #ifdef DEBUG
+    qRegisterMetaType<std::vector<std::string>>();
+    #endif
+    // A build for an edit that has been typed over is no use, the next one starts it again
+    root.setStopCheck([this] { return building != generation; });
+    context->moveToThread(&thread);
+    thread.start();
+}
+
+ParseWorker::~ParseWorker() {
+    ++generation; // So a parse still running stops at its next check
+    thread.quit();
+    thread.wait();
+    // Safe now the thread has stopped, anything still queued is dropped with it
+    delete context;
+}
+
+void ParseWorker::post(std::function<void()> work) {
+    QMetaObject::invokeMethod(context, std::move(work), Qt::QueuedConnection);
+}
+
+void ParseWorker::reset(std::vector<std::string> lines) {
+    ++generation;
+    post([this, lines = std::move(lines)]() mutable {
+        lexer.reset(std::move(lines));
+        rebuild = true;
+    });
+}
+
+void ParseWorker::update(size_t first, size_t removed, std::vector<std::string> lines) {
+    ++generation;
+    post([this, first, removed, lines = std::move(lines)]() mutable {
+        // Everything after the edit moves by however many bytes it added
+        int64_t shift = 0;
+        for (size_t i = first; i < std::min(first + removed, lexer.getLineCount()); ++i) shift -= lexer.getLine(i).size();
+        for (const std::string &line : lines) shift += line.size();
+        IncrementalLexer::LineRange range = lexer.update(first, removed, std::move(lines));
+        edit(range, (int32_t)shift);
+    });
+}
+
+void ParseWorker::parse() {
+    uint64_t wanted = generation;
+    post([this, wanted] {
+        Result result;
+        if (build(wanted, result)) emit parsed(result);
+    });
+}
+
+#ifdef DEBUG
+void ParseWorker::preview() {
+    post([this] {
+        Result result;
+        build(generation, result);
+        std::vector<std::string> tree;
+        root.getAsVector(tree, lexer.getText());
+        emit previewReady(tree);
+    });
+}
+#endif
+
+// Saves the edit up until the next build, so however many come in between only one rebuild is done
+void ParseWorker::edit(const IncrementalLexer::LineRange &range, int32_t offsetShift) {
+    IntermediateNode::TokenEdit next = {(uint32_t)range.firstToken, (uint32_t)range.removedTokens,
+            (uint32_t)range.addedTokens, offsetShift};
+    pending = edited ? pending.then(next) : next;
+    edited = true;
+}
+
+// Brings the tree up to date with the lexer and checks it, gives false if the document moved on past wanted in the meantime
+bool ParseWorker::build(uint64_t wanted, Result &result) {
+    if (wanted != generation) return false;
+    building = wanted;
+    auto start = std::chrono::steady_clock::now();
+
+    // Only the tokens of the statements it re-parses are looked up from the lexer's lines,
+            // the whole text is only put together when all of the tree has to be built
+    if (!rebuild && edited) {
+        std::string scratch[2];
+        rebuild = !root.updateTree(lexer.getTokenCount(), [&](size_t index) {
+            const LexToken token = lexer.getToken(index);
+            return IntermediateNode::TokenText{lexer.getTokenText(token, scratch[index % 2]), token.offset};
+        }, pending);
+    }
+    // The tree copies what it needs out of the text, so the snapshot can go once it is built
+    if (rebuild) root.generateTree(lexer.getText(), lexer.getTokens());
+    rebuild = false;
+    edited = false;
+
+    // A build that stopped partway left the tree for the next one to build again
+    if (wanted != generation) return false;
+    result.errors = root.getErrors();
+    result.places.reserve(result.errors.size());
+    for (const SyntaxError &error : result.errors) {
+        const size_t line = lexer.getLineAt(error.getOffset());
+        result.places.push_back({(uint32_t)line, error.getOffset() - (uint32_t)lexer.getLineStart(line)});
+    }
+
+    result.generation = wanted;
+    result.tokens = root.getTokenCount();
+    result.nodes = root.getNodeCount();
+    result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,80 @@
+/* parseworker.h
+PURPOSE:
+- Keeps a parse of the open document up to date on its own thread so that compiling never holds up typing
+*/
+#ifndef PARSEWORKER_H
+#define PARSEWORKER_H
+
+#include "defines.h"
+#include "incrementallexer.h"
+#include "intermediatenode.h"
+#include <QObject>
+#include <QThread>
+#include <QMetaType>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class ParseWorker : public QObject {
+    Q_OBJECT
+
+public:
+    // Where an error is in the document, both counted from 0 and the column in bytes
+    struct Place {
+        uint32_t line, column;
+    };
+    struct Result {
+        uint64_t generation = 0; // Which edit it is up to date with
+        size_t tokens = 0, nodes = 0;
+        double millis = 0; // Time spent building and checking the tree
+        std::vector<SyntaxError> errors; // Sorted by position
+        std::vector<Place> places; // One for each error, looked up from the lexer's lines so the text is never put together
+    };
+
+    ParseWorker(QObject *parent = nullptr);
+    ~ParseWorker();
+
+    // Everything public is called from the UI thread, it only queues the work and returns straight away,
+            // edits are applied in the order they are given and each one cancels any parse still running
+    void reset(std::vector<std::string> lines);
+    void update(size_t first, size_t removed, std::vector<std::string> lines);
+    // Parses the document as of the last edit, skipped if another edit comes in first
+    void parse();
+    #ifdef DEBUG
+    // Parses whatever the latest edit is and sends the tree back laid out by getAsVector()
+    void preview();
+    #endif
+
+signals:
+    void parsed(const ParseWorker::Result &result);
+    #ifdef DEBUG
+    void previewReady(const std::vector<std::string> &tree);
+    #endif
+
+private:
+    QThread thread;
+    QObject *context; // Lives on the thread, queued calls to it are how work gets there
+    std::atomic<uint64_t> generation = 0; // Bumped by every edit, a parse for an older one is stale
+
+    // Only touched on the worker's thread
+    IncrementalLexer lexer;
+    IntermediateNode root;
+    IntermediateNode::TokenEdit pending = {0, 0, 0, 0}; // Every edit since the tree was last built, as one
+    bool edited = false, rebuild = true;
+    // The edit the build going on is for, it stops partway once another comes in.
+    // Set on the worker's thread but read by the stop check, which a parallel build also calls from its own threads
+    std::atomic<uint64_t> building = 0;
+
+    void post(std::function<void()> work);
+    void edit(const IncrementalLexer::LineRange &range, int32_t offsetShift);
+    bool build(uint64_t wanted, Result &result);
+};
+
+Q_DECLARE_METATYPE(ParseWorker::Result)
+#ifdef DEBUG
+Q_DECLARE_METATYPE(std::vector<std::string>)
+#endif
+
+#endif // PARSEWORKER_H
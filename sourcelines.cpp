@@ -0,0 +1,36 @@
+/* sourcelines.cpp
+PURPOSE:
+- Where each line of a text starts, so tokens and nodes only need to keep a byte offset and the line and column are found when shown
+*/
+#include "sourcelines.h"
+#include "bytescan.h"
+#include <algorithm>
+
+SourceLines::SourceLines() : starts(1, 0) {}
+
+SourceLines::SourceLines(std::string_view text) {
+    reset(text);
+}
+
+void SourceLines::reset(std::string_view text) {
+    starts.assign(1, 0);
+    // Stopping at a '\n' or a '\n' is the same scan strings and comments use
+    for (size_t i = ByteScan::skipUntil(text, 0, '\n'); i < text.size(); i = ByteScan::skipUntil(text, i + 1, '\n'))
+        starts.push_back((uint32_t)i + 1);
+}
+
+size_t SourceLines::getLineCount() const {
+    return starts.size();
+}
+
+uint32_t SourceLines::getLineStart(uint32_t line) const {
+    return starts[std::min<size_t>(line, starts.size() - 1)];
+}
+
+uint32_t SourceLines::getLine(uint32_t offset) const {
+    return (uint32_t)(std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1);
+}
+
+uint32_t SourceLines::getColumn(uint32_t offset) const {
+    return offset - starts[getLine(offset)];
+}
@@ -0,0 +1,31 @@
+/* sourcelines.h
+PURPOSE:
+- Where each line of a text starts, so tokens and nodes only need to keep a byte offset and the line and column are found when shown
+*/
+#ifndef SOURCELINES_H
+#define SOURCELINES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class SourceLines {
+public:
+    // Same as an empty text, a single line starting at 0
+    SourceLines();
+    explicit SourceLines(std::string_view text);
+    // One pass over the text, the line breaks are found a vector at a time by ByteScan
+    void reset(std::string_view text);
+
+    size_t getLineCount() const;
+    uint32_t getLineStart(uint32_t line) const;
+    // Both counted from 0, an offset on a '\n' is on the line the '\n' ends
+    uint32_t getLine(uint32_t offset) const;
+    uint32_t getColumn(uint32_t offset) const;
+
+private:
+    std::vector<uint32_t> starts;
+};
+
+#endif // SOURCELINES_H
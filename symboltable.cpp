@@ -0,0 +1,103 @@
+/* symboltable.cpp
+PURPOSE:
+- Interns the text of tokens so a token only holds a small id, the same text anywhere in a project is only stored once
+*/
+#include "symboltable.h"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+namespace {
+
+// Has to line up with the named ids in the Symbol enum
+constexpr std::string_view predefined[] = {
+    "",
+    ",", "(", ")", "()", "[", "]", "[]",
+    "=", "==", "<", ">", "≤", "≥", "≠", "≈", "!", "~", "+", "-", "*", "**", "/", "//", "%", "^", "&", "|",
+    "xor", "and", "or", "not",
+    "create", "open", "file", "colorset", "foreach", "using", "export", "output",
+    "as", "in", "do",
+    "true", "false", "this", "const"
+};
+static_assert(std::size(predefined) == (size_t)Symbol::PREDEFINED, "every named symbol needs its text");
+
+}
+
+SymbolTable& SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+SymbolTable::SymbolTable() {
+    slots.resize(1024);
+    for (std::string_view text : predefined) intern(text);
+}
+
+Symbol SymbolTable::intern(std::string_view text) {
+    const size_t hash = std::hash<std::string_view>{}(text);
+    {
+        std::shared_lock lock(mutex);
+        if (uint32_t index = slots[findSlot(text, hash)].index; index != 0) return (Symbol)(index - 1);
+    }
+    std::unique_lock lock(mutex);
+    // Another thread could have added it between the two locks
+    size_t slot = findSlot(text, hash);
+    if (slots[slot].index != 0) return (Symbol)(slots[slot].index - 1);
+    texts.push_back(store(text));
+    slots[slot] = {hash, (uint32_t)texts.size()};
+    // Kept at most half full so probes stay short
+    if (texts.size() * 2 > slots.size()) grow();
+    return (Symbol)(texts.size() - 1);
+}
+
+Symbol SymbolTable::find(std::string_view text) const {
+    std::shared_lock lock(mutex);
+    const uint32_t index = slots[findSlot(text, std::hash<std::string_view>{}(text))].index;
+    return index != 0 ? (Symbol)(index - 1) : Symbol::EMPTY;
+}
+
+std::string_view SymbolTable::getText(Symbol symbol) const {
+    std::shared_lock lock(mutex);
+    return texts[(size_t)symbol];
+}
+
+size_t SymbolTable::size() const {
+    std::shared_lock lock(mutex);
+    return texts.size();
+}
+
+size_t SymbolTable::findSlot(std::string_view text, size_t hash) const {
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+        const Slot &entry = slots[slot];
+        if (entry.index == 0 || (entry.hash == hash && texts[entry.index - 1] == text)) return slot;
+    }
+}
+
+void SymbolTable::grow() {
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    const size_t mask = slots.size() - 1;
+    for (const Slot &entry : old) {
+        if (entry.index == 0) continue;
+        size_t slot = entry.hash & mask;
+        while (slots[slot].index != 0) slot = (slot + 1) & mask;
+        slots[slot] = entry;
+    }
+}
+
+std::string_view SymbolTable::store(std::string_view text) {
+    constexpr size_t blockSize = 64 * 1024;
+    if (text.size() > blockLeft) {
+        // Anything too big for a block gets one to itself
+        size_t size = std::max(text.size(), blockSize);
+        blocks.push_back(std::make_unique<char[]>(size));
+        blockNext = blocks.back().get();
+        blockLeft = size;
+    }
+    std::copy(text.begin(), text.end(), blockNext);
+    std::string_view stored(blockNext, text.size());
+    blockNext += text.size();
+    blockLeft -= text.size();
+    return stored;
+}
@@ -0,0 +1,110 @@
+/* symboltable.h
+PURPOSE:
+- Interns the text of tokens so a token only holds a small id, the same text anywhere in a project is only stored once
+- Ids are compared instead of strings, the words the compiler itself looks for have fixed ids so it never has to look them up
+*/
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+
+// The named ones are interned when the table is made, in this order, ids after them are handed out as text comes in
+enum class Symbol : uint32_t {
+    EMPTY = 0,
+    // Punctuation
+    COMMA, // ,
+    OPEN_PAREN, // (
+    CLOSE_PAREN, // )
+    PARENS, // () a closed bracket
+    OPEN_SQUARE, // [
+    CLOSE_SQUARE, // ]
+    SQUARES, // [] a closed list
+    // Operators
+    ASSIGN, // =
+    EQUALS, // ==
+    LESS, // <
+    GREATER, // >
+    LESS_EQUAL, // ≤
+    GREATER_EQUAL, // ≥
+    NOT_EQUAL, // ≠
+    APPROX, // ≈
+    BANG, // !
+    TILDE, // ~
+    PLUS, // +
+    MINUS, // -
+    STAR, // *
+    POWER, // **
+    SLASH, // /
+    DOUBLE_SLASH, // //
+    PERCENT, // %
+    CARET, // ^
+    AMPERSAND, // &
+    PIPE, // |
+    XOR,
+    AND,
+    OR,
+    NOT,
+    // Keywords
+    CREATE,
+    OPEN,
+    FILE,
+    COLORSET,
+    FOREACH,
+    USING,
+    EXPORT,
+    OUTPUT,
+    // Fillers
+    AS,
+    IN,
+    DO,
+    // Literals
+    TRUE,
+    FALSE,
+    THIS,
+    CONST,
+    PREDEFINED // How many named ones there are
+};
+
+class SymbolTable {
+public:
+    // The one table for the whole project, every thread shares it so ids can be compared between files
+    static SymbolTable& global();
+
+    // Gives the id the text already has, or a new one
+    Symbol intern(std::string_view text);
+    // Gives the id the text already has, or EMPTY without adding it, for text that should not stay in the table
+    Symbol find(std::string_view text) const;
+    // Stays valid for as long as the program runs
+    std::string_view getText(Symbol symbol) const;
+    size_t size() const;
+
+private:
+    SymbolTable();
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    // Open addressing, the hash is kept so probing only compares text when the hashes match
+    struct Slot {
+        size_t hash;
+        uint32_t index; // One past the symbol's id, 0 for an empty slot
+    };
+    // Where the text is, or the empty slot it would go in
+    size_t findSlot(std::string_view text, size_t hash) const;
+    void grow();
+    // Copies the text into storage that never moves
+    std::string_view store(std::string_view text);
+
+    // Lookups far outnumber new text, so readers share the lock
+    mutable std::shared_mutex mutex;
+    std::vector<std::string_view> texts;
+    std::vector<Slot> slots;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *blockNext = nullptr;
+    size_t blockLeft = 0;
+};
+
+#endif // SYMBOLTABLE_H
@@ -5,6 +5,7 @@ PURPOSE:
 #ifndef SYNTAXERROR_HPP
 #define SYNTAXERROR_HPP
 
+#include "sourcelines.h"
 #include <cstdint>
 #include <string>
 #include <iostream>
@@ -13,34 +14,40 @@ class SyntaxError {
 public:
     enum class SyntaxErrorType {
         IncompletePhrase,
-        UnknownToken
+        UnknownToken,
+        UnmatchedBracket
     };
 
-    SyntaxError(SyntaxErrorType type, uint32_t line, uint32_t pos)
-        : type(type), line(line), pos(pos) {}
+    // Spans the same bytes as the token it is about
+    SyntaxError(SyntaxErrorType type, uint32_t offset, uint32_t length = 1)
+        : type(type), offset(offset), length(length) {}
 
-    SyntaxErrorType getType() {
+    SyntaxErrorType getType() const {
         return type;
     }
 
-    uint32_t getLine() {
-        return line;
+    uint32_t getOffset() const {
+        return offset;
     }
 
-    uint32_t getPos() {
-        return pos;
+    uint32_t getLength() const {
+        return length;
     }
 
-    void printMessage(std::ostream& os);
+    // Ordered by where they are in the text
+    bool operator<(const SyntaxError& other) const {
+        return offset < other.offset;
+    }
+
+    // Lines are those of the text it was found in, shown counting from 1 like an editor does
+    void printMessage(std::ostream& os, const SourceLines& lines) const;
 
 private:
     SyntaxErrorType type;
-    uint32_t line, pos;
+    uint32_t offset, length;
 };
 
-#endif // SYNTAXERROR_HPP
-
-inline void SyntaxError::printMessage(std::ostream& os) {
+inline void SyntaxError::printMessage(std::ostream& os, const SourceLines& lines) const {
     os << "Error: ";
     switch(type) {
     case SyntaxError::SyntaxErrorType::IncompletePhrase:
@@ -49,6 +56,11 @@ inline void SyntaxError::printMessage(std::ostream& os) {
     case SyntaxError::SyntaxErrorType::UnknownToken:
         os << "Cannot parse token";
         break;
+    case SyntaxError::SyntaxErrorType::UnmatchedBracket:
+        os << "Unmatched bracket";
+        break;
     }
-    os << " on Line " << line << ":" << pos << ".\n";
-}
\ No newline at end of file
+    os << " on Line " << lines.getLine(offset) + 1 << ":" << lines.getColumn(offset) + 1 << ".\n";
+}
+
+#endif // SYNTAXERROR_HPP
@@ -3,81 +3,115 @@ PURPOSE:
 - Highlights text based on WBS syntax
 */
 #include "syntaxhighlighter.h"
-#include <QRegExp>
+#include "token.hpp"
+#include <string_view>
 
-SyntaxHighlighter::SyntaxHighlighter(QTextDocument *parent) : QSyntaxHighlighter(parent) {}
-
-void SyntaxHighlighter::highlightBlock(const QString &text) {
-    // 5. Symbol Highlighting (Priority 5)
-    QTextCharFormat symbolFormat;
+SyntaxHighlighter::SyntaxHighlighter(QTextDocument *parent) : QSyntaxHighlighter(parent) {
     symbolFormat.setForeground(Qt::darkMagenta);
-    QStringList symbolPatterns = {
-        "\\(", "\\)", "\\{", "\\}", "\\[", "\\]",
-        "\\+", "-", "\\*", "\\/", "=", "!", "%",
-        "\\^", "\\|", "~", "<", ">", ",", "\\.", 
-        ";", ":", "'", "\"", "#", "\\$", "&", 
-        "\\?", "@", "_", "\\|", "\\\\", "→", "←", 
-        "↑", "↓", "≥", "≤", "≡", "≈", "×", "·", 
-        "•"
-    };
-    for (const QString &pattern : symbolPatterns) {
-        QRegExp symbolExpression(pattern);
-        int symbolIndex = symbolExpression.indexIn(text);
-        while (symbolIndex >= 0) {
-            int length = symbolExpression.matchedLength();
-            setFormat(symbolIndex, length, symbolFormat);
-            symbolIndex = symbolExpression.indexIn(text, symbolIndex + length);
+    numberFormat.setForeground(Qt::darkYellow);
+    keywordFormat.setForeground(Qt::blue);
+    stringFormat.setForeground(Qt::red);
+    commentFormat.setForeground(Qt::darkGreen);
+}
+
+// The lexer counts bytes, the block counts UTF-16 units, so both are worked out in the one pass over the units
+void SyntaxHighlighter::encode(const QString &text) {
+    utf8.clear();
+    columns.clear();
+    const qsizetype size = text.size();
+    for (qsizetype i = 0; i < size; ++i) {
+        char32_t c = text[i].unicode();
+        if (c < 0x80 && columns.empty()) {
+            utf8 += (char)c;
+            continue;
+        }
+        // Up to here it was ASCII, where bytes and columns are the same
+        if (columns.empty()) {
+            columns.reserve(size * 3 + 1);
+            for (size_t byte = 0; byte < utf8.size(); ++byte) columns.push_back((int)byte);
+        }
+        const int column = (int)i;
+        int width = 1;
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < size && text[i + 1].unicode() >= 0xDC00 && text[i + 1].unicode() <= 0xDFFF) {
+            // A surrogate pair is one character of two columns
+            c = 0x10000 + ((c - 0xD800) << 10) + (text[++i].unicode() - 0xDC00);
+            width = 2;
+        } else if (c >= 0xD800 && c <= 0xDFFF) c = 0xFFFD; // Same as toUtf8() gives for half a pair
+        const size_t start = utf8.size();
+        if (c < 0x80) utf8 += (char)c;
+        else if (c < 0x800) {
+            utf8 += (char)(0xC0 | c >> 6);
+            utf8 += (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            utf8 += (char)(0xE0 | c >> 12);
+            utf8 += (char)(0x80 | (c >> 6 & 0x3F));
+            utf8 += (char)(0x80 | (c & 0x3F));
+        } else {
+            utf8 += (char)(0xF0 | c >> 18);
+            utf8 += (char)(0x80 | (c >> 12 & 0x3F));
+            utf8 += (char)(0x80 | (c >> 6 & 0x3F));
+            utf8 += (char)(0x80 | (c & 0x3F));
         }
+        // Ending on a continuation byte takes in the rest of its character
+        columns.push_back(column);
+        for (size_t byte = start + 1; byte < utf8.size(); ++byte) columns.push_back(column + width);
     }
+    if (!columns.empty()) columns.push_back((int)size);
+}
 
-    // 4. Number Highlighting (Priority 4)
-    QTextCharFormat numberFormat;
-    numberFormat.setForeground(Qt::darkYellow);
-    QRegExp numberPattern("\\b(?![a-zA-Z_])[0-9]+(?:\\.[0-9]+)?\\b");  // Find numbers unless they are part of a word
-    int numberIndex = numberPattern.indexIn(text);
-    while (numberIndex >= 0) {
-        int length = numberPattern.matchedLength();
-        setFormat(numberIndex, length, numberFormat);
-        numberIndex = numberPattern.indexIn(text, numberIndex + length);
-    }
+// One pass of the compiler's own lexer over the block, so what is coloured as a string, word or symbol is exactly what gets compiled
+void SyntaxHighlighter::highlightBlock(const QString &text) {
+    encode(text);
+    const std::string_view source = utf8;
+    auto toColumn = [&](size_t offset) { return columns.empty() ? (int)offset : columns[offset]; };
+    auto apply = [&](size_t start, size_t end, const QTextCharFormat &charFormat) {
+        int from = toColumn(start), to = toColumn(end);
+        if (to > from) setFormat(from, to - from, charFormat);
+    };
 
-    // 3. Keyword Highlighting (Priority 3)
-    QTextCharFormat keywordFormat;
-    keywordFormat.setForeground(Qt::blue);
-    #ifdef Ver0_1_0
-    QStringList keywordPatterns = { "\\bconst\\b", "\\bcreate\\b", "\\bopen\\b", "\\bfile\\b", "\\bcolorset\\b", "\\bforeach\\b", "\\busing\\b", "\\bexport\\b", "\\boutput\\b", "\\bin\\b", "\\bas\\b", "\\bdo\\b", "\\bxor\\b", "\\band\\b", "\\bor\\b", "\\bnot\\b" };
-    #else
-    QStringList keywordPatterns = { "\\bconst\\b", "\\bcreate\\b", "\\bopen\\b", "\\bfile\\b", "\\bcolorset\\b", "\\bforeach\\b", "\\busing\\b", "\\bexport\\b", "\\boutput\\b", "\\bin\\b", "\\bas\\b", "\\bdo\\b", "\\bxor\\b", "\\band\\b", "\\bor\\b", "\\bnot\\b" };
-    #endif
-    for (const QString &pattern : keywordPatterns) {
-        QRegExp expression(pattern);
-        int index = expression.indexIn(text);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            setFormat(index, length, keywordFormat);
-            index = expression.indexIn(text, index + length);
-        }
+    // Strings are the only thing that carries on over a line break, so whether one is open is the whole block state,
+            // Qt only moves on to highlight the next block when that changes
+    LexState state;
+    if (previousBlockState() == inString) {
+        state.inString = true;
+        state.tokenStart = 0;
+        state.kind = LexToken::Kind::STRING;
     }
+    tokens.clear();
+    TokenParser::lexChunk(source, state, tokens);
+    setCurrentBlockState(state.inString ? inString : plain);
+    TokenParser::lexFinish(state, tokens); // A string left open runs to the end of the block
 
-    // 2. String Highlighting (Priority 2)
-    QTextCharFormat stringFormat;
-    stringFormat.setForeground(Qt::red);
-    QRegExp stringPattern("\"[^\"]*\"");  // Find text inside double quotes
-    int stringIndex = stringPattern.indexIn(text);
-    while (stringIndex >= 0) {
-        int length = stringPattern.matchedLength();
-        setFormat(stringIndex, length, stringFormat);
-        stringIndex = stringPattern.indexIn(text, stringIndex + length);
+    uint32_t end = 0;
+    for (const LexToken &token : tokens) {
+        end = token.offset + token.length;
+        switch (token.kind) {
+            case LexToken::Kind::STRING:
+                apply(token.offset, end, stringFormat);
+                break;
+            case LexToken::Kind::SYMBOL:
+                apply(token.offset, end, symbolFormat);
+                break;
+            case LexToken::Kind::WORD: {
+                // The same table the compiler takes words from, anything in it but the literals is coloured as a keyword,
+                        // the word operators included
+                std::string_view word = token.text(source);
+                if (const LiteralTable::Entry *entry = LiteralTable::find(word)) {
+                    if (entry->type != Token::TokenType::BOOL_LITERAL && entry->type != Token::TokenType::THIS_LITERAL)
+                        apply(token.offset, end, keywordFormat);
+                    break;
+                }
+                Token::TokenType literal = Token::getLiteral(word, false);
+                if (literal == Token::TokenType::NUMERIC_LITERAL || literal == Token::TokenType::COLOR_LITERAL)
+                    apply(token.offset, end, numberFormat);
+                break;
+            }
+        }
     }
 
-    // 1. Comment Highlighting (Priority 1)
-    QTextCharFormat commentFormat;
-    commentFormat.setForeground(Qt::darkGreen);
-    QRegExp commentPattern("//[^\n]*");
-    int commentIndex = commentPattern.indexIn(text);
-    while (commentIndex >= 0) {
-        int length = commentPattern.matchedLength();
-        setFormat(commentIndex, length, commentFormat);
-        commentIndex = commentPattern.indexIn(text, commentIndex + length);
+    // Comments run to the end of the line and the lexer drops them, nothing but whitespace is between the last token and one
+    if (state.inComment) {
+        size_t start = source.find("//", end);
+        if (start != std::string_view::npos) apply(start, source.size(), commentFormat);
     }
 }
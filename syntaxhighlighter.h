@@ -6,9 +6,11 @@ PURPOSE:
 #define SYNTAXHIGHLIGHTER_H
 
 #include "defines.h"
+#include "tokenparser.h"
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
-#include <QStringList>
+#include <string>
+#include <vector>
 
 class SyntaxHighlighter : public QSyntaxHighlighter {
     Q_OBJECT
@@ -18,6 +20,22 @@ public:
 
 protected:
     void highlightBlock(const QString &text) override;
+
+private:
+    // Block states, a block with none set is at the start of the document
+    enum BlockState {
+        plain = 0,
+        inString = 1
+    };
+
+    QTextCharFormat symbolFormat, numberFormat, keywordFormat, stringFormat, commentFormat;
+    // Reused between blocks so highlighting a block does not allocate
+    std::string utf8;
+    std::vector<LexToken> tokens;
+    std::vector<int> columns;
+
+    // Writes the block into utf8 and, only when it is not plain ASCII, the column each byte is at into columns
+    void encode(const QString &text);
 };
 
 #endif // SYNTAXHIGHLIGHTER_H
@@ -6,17 +6,17 @@ PURPOSE:
 #ifndef TOKEN_HPP
 #define TOKEN_HPP
 
+#include "bytescan.h"
 #include "defines.h"
 #include "notimplementedexception.hpp"
+#include "symboltable.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <cstdint>
-
-// From https://stackoverflow.com/questions/16388510/evaluate-a-string-with-a-switch-in-c
-// Credit to @Serhiy
-constexpr unsigned int str2int(const char* str, int h = 0)
-{
-    return !str[h] ? 5381 : (str2int(str, h+1) * 33) ^ str[h];
-}
+#include <type_traits>
 
 class Token {
 public:
@@ -52,19 +52,19 @@ public:
     - argument list, the other of the two, works similar but has assignments not value expressions
 
     */
-    enum class TokenType {
+    enum class TokenType : uint8_t {
         UNSET = 0,
         CONST,
         KEYWORD,
         FILLER, // Just used during construction to ensure syntax, but ignored in execution
         NAME,
         HTMLPART,
-        STRING_LITERAL, // Quote marks are removed upon construction
-        BOOL_LITERAL,
-        NUMERIC_LITERAL,
+        STRING_LITERAL, // Left behind its span with the quote marks, getValueText() decodes it
+        BOOL_LITERAL, // Held as a bool
+        NUMERIC_LITERAL, // Held as an int64_t when it has no '.' and fits, as a double otherwise
         THIS_LITERAL, // The value is undefined because it is not needed
         FILE_LITERAL,
-        COLOR_LITERAL, // Hashtag are removed upon construction
+        COLOR_LITERAL, // Held packed as 0xRRGGBBAA, #RGB, #RGBA, #RRGGBB and #RRGGBBAA are the only forms
         LIST_LITERAL,
         ARGUMENT_LIST,
         UNARY_OPERATOR, // All unary operators are prefix
@@ -74,104 +74,419 @@ public:
     };
 
     Token();
-    Token(Token &token);
-    Token(TokenType literalType, const std::string& value, const uint32_t& line,
-        const uint32_t& pos, bool first, bool inLink, bool inHtml);
-    Token(TokenType type, const std::string& value, const uint32_t& line,
-        const uint32_t& pos);
-    Token& operator=(const Token& other);
+    Token(TokenType literalType, std::string_view value, uint32_t offset,
+        bool first, bool inLink, bool inHtml);
+    Token(TokenType type, Symbol value, uint32_t offset, uint32_t length = 1);
 
     TokenType getType() const;
-    const std::string& getValue() const;
-    void setValue(const std::string& value);
-    const uint32_t& getLine() const;
-    const uint32_t& getPos() const;
-
+    // The value as an id, compare these rather than the text, EMPTY for strings and the literals held as machine values below
+    Symbol getSymbol() const;
+    // Looked up in the symbol table, so only for when the text itself is needed, the literal's source is behind its span
+    std::string_view getValue() const;
+    void setValue(Symbol value);
+    void setValue(std::string_view value);
+    // Only meaningful for their own type of literal, decoded once when the token is made
+    bool isInteger() const;
+    int64_t getInteger() const;
+    double getNumber() const; // Integers too
+    uint32_t getColor() const;
+    bool getBool() const;
+    // Compares whatever the value is held as, symbol or machine value
+    bool hasSameValue(Token other) const;
+    // The value written out, for showing rather than compiling, strings and unknown tokens only keep their span so for them
+            // it comes from text, the token's own source
+    std::string getValueText(std::string_view text = {}) const;
+    // Where in the source it starts in bytes, SourceLines gives the line and column
+    uint32_t getOffset() const;
+    void setOffset(uint32_t offset);
+    // Bytes of source it was made from, from getOffset() on, it stops counting at 8MB
+    uint32_t getLength() const;
+
+    // A token is 16 bytes and trivially copyable, so these all take it by value
     static uint32_t getPhraseLength(Token kw);
     static bool doesAcceptInPosition(Token kw, Token t, uint32_t pos, bool final);
     static bool isPureValueExpression(Token t);
     static bool isValueExpression(Token t);
     static bool isFullPhrase(Token t);
     static bool isPhrase(Token t);
-    static TokenType getLiteral(std::string token, bool inLink);
+    static TokenType getLiteral(std::string_view token, bool inLink);
+    // How tightly an operator holds on to its operands, higher binds first, 0 for anything that is not an operator
+    static uint8_t getPrecedence(Token t);
+    // Only '**' groups from the right, a ** b ** c is a ** (b ** c)
+    static bool isRightAssociative(Token t);
+    // The operator t makes with the token after it, like '*' and '*' making '**', or EMPTY if they stay apart
+    static Symbol getCompound(Token t, std::string_view next);
 
 private:
-    TokenType type;
-    std::string value;
-    uint32_t line, pos;
+    // Keeps the fields of many tokens in arrays of their own
+    friend class FlatTree;
+
+    static constexpr bool holdsSymbol(TokenType type);
+    static constexpr uint32_t maxLength = (1u << 23) - 1;
+
+    TokenType type : 8;
+    uint32_t integer : 1; // Which of the two a numeric literal is held as
+    uint32_t length : 23;
+    uint32_t offset;
+    // Which one is set depends on the type, the rest of the 8 bytes are always zeroed so they compare as a whole
+    union Value {
+        int64_t integer;
+        double number;
+        Symbol symbol; // Interned in SymbolTable::global()
+        uint32_t color;
+        bool flag;
+    } value;
+    void setSymbol(Symbol symbol);
 };
 
-inline Token::Token() 
-    : type(Token::TokenType::UNSET), value(""), line(0), pos(0) {}
+constexpr bool Token::holdsSymbol(TokenType type) {
+    return type != Token::TokenType::BOOL_LITERAL && type != Token::TokenType::NUMERIC_LITERAL &&
+            type != Token::TokenType::COLOR_LITERAL;
+}
+
+static_assert(sizeof(Token) <= 16, "tokens are kept in big arrays and passed by value");
+static_assert(std::is_trivially_copyable_v<Token>);
+
+// The grammar of language.ebns the way the tree takes it in, a token at a time, with the tables the lookups use built
+        // from it at compile time, so what a phrase takes and how many children it has are only written down here
+namespace GrammarTable {
+    using Type = Token::TokenType;
+
+    // What a token is to the grammar, its type, with the few that also depend on their symbol getting kinds of their own
+    enum Kind : uint8_t {
+        FILLER_COMMA = (uint8_t)Type::UNKNOWN + 1,
+        FILLER_IN,
+        FILLER_AS,
+        FILLER_DO,
+        CALL, // The binary '(' in front of an argument list
+        KINDS
+    };
+    // A set of kinds, one bit each
+    using Mask = uint32_t;
+    static_assert(KINDS <= 32, "every kind needs a bit of a mask");
+
+    constexpr Mask bit(Type type) {
+        return Mask(1) << (uint8_t)type;
+    }
+    constexpr Mask bit(Kind kind) {
+        return Mask(1) << kind;
+    }
+
+    constexpr uint8_t kindOf(Type type, Symbol symbol) {
+        switch (type) {
+            case Type::FILLER:
+                switch (symbol) {
+                    case Symbol::COMMA:
+                        return FILLER_COMMA;
+                    case Symbol::IN:
+                        return FILLER_IN;
+                    case Symbol::AS:
+                        return FILLER_AS;
+                    case Symbol::DO:
+                        return FILLER_DO;
+                    default:
+                        break;
+                }
+                break;
+            case Type::BINARY_OPERATOR:
+                if (symbol == Symbol::OPEN_PAREN) return CALL;
+                break;
+            default:
+                break;
+        }
+        return (uint8_t)type;
+    }
+
+    // The groups language.ebns names, statements are full phrases and phrases are anything with children
+    constexpr Mask pureValueExpression = bit(Type::NAME) | bit(Type::STRING_LITERAL) | bit(Type::BOOL_LITERAL) |
+            bit(Type::NUMERIC_LITERAL) | bit(Type::THIS_LITERAL) | bit(Type::COLOR_LITERAL) | bit(Type::LIST_LITERAL) |
+            bit(Type::UNARY_OPERATOR) | bit(Type::BINARY_OPERATOR) | bit(CALL);
+    constexpr Mask valueExpression = pureValueExpression | bit(Type::KEYWORD);
+    constexpr Mask fullPhrase = valueExpression | bit(Type::CONST);
+    constexpr Mask phrase = bit(Type::LIST_LITERAL) | bit(Type::UNARY_OPERATOR) | bit(Type::BINARY_OPERATOR) | bit(CALL) |
+            bit(Type::KEYWORD) | bit(Type::CONST) | bit(Type::ASSIGNMENT) | bit(Type::ARGUMENT_LIST);
+
+    // Phrases are found by their kind, keywords get rows after the kinds in the same order as their symbols
+    constexpr uint8_t keywordRow(Symbol keyword) {
+        return KINDS + (uint8_t)((uint32_t)keyword - (uint32_t)Symbol::CREATE);
+    }
+    constexpr uint8_t rowCount = keywordRow(Symbol::OUTPUT) + 1;
+    constexpr uint32_t any = -1; // The arity of the lists, -1 (the uint32_t max) represents variable length
+    constexpr uint32_t maxPositions = 5;
+
+    // What a position takes once the phrase is done, and what else it takes while the phrase is still being built
+    struct Position {
+        Mask accepts;
+        Mask building;
+    };
+    struct Rule {
+        uint8_t row;
+        uint32_t arity;
+        Position positions[maxPositions]; // Only the first for the lists, every position takes the same
+    };
+
+    // Assignments are built up with the name first, so whatever takes one takes a name until it is finished
+    constexpr Position assigned = {bit(Type::ASSIGNMENT), bit(Type::NAME)};
+    constexpr Position value = {valueExpression, 0};
+
+    inline constexpr Rule rules[] = {
+        // "create" <htmlpart> or an applied argument list
+        {keywordRow(Symbol::CREATE), 1, {{bit(Type::HTMLPART) | bit(CALL), 0}}},
+        // "open" and "file" <file>
+        {keywordRow(Symbol::OPEN), 1, {{bit(Type::FILE_LITERAL), 0}}},
+        {keywordRow(Symbol::FILE), 1, {{bit(Type::FILE_LITERAL), 0}}},
+        // "colorset" and three assignments
+        {keywordRow(Symbol::COLORSET), 3, {assigned, assigned, assigned}},
+        // "foreach" <name> "in" <value-expression> "do" <statement>
+        {keywordRow(Symbol::FOREACH), 5, {{bit(Type::NAME), 0}, {bit(FILLER_IN), 0}, value, {bit(FILLER_DO), 0}, {fullPhrase, 0}}},
+        // "using" <value-expression> "as" <name> "do" <statement>
+        {keywordRow(Symbol::USING), 5, {value, {bit(FILLER_AS), 0}, {bit(Type::NAME), 0}, {bit(FILLER_DO), 0}, {fullPhrase, 0}}},
+        // "export" and "output" <value-expression>
+        {keywordRow(Symbol::EXPORT), 1, {value}},
+        #ifdef Ver0_1_0
+        {keywordRow(Symbol::OUTPUT), 1, {value}},
+        #endif
+        // <name> "=" <value-expression>
+        {(uint8_t)Type::ASSIGNMENT, 2, {{bit(Type::NAME), 0}, value}},
+        // "const" <assignment>
+        {(uint8_t)Type::CONST, 1, {assigned}},
+        {(uint8_t)Type::UNARY_OPERATOR, 1, {value}},
+        {(uint8_t)Type::BINARY_OPERATOR, 2, {value, value}},
+        // (<htmlpart> | <name>) <arglist>, or anything else that gives back something to call
+        {CALL, 2, {{valueExpression | bit(Type::HTMLPART), 0}, {bit(Type::ARGUMENT_LIST), 0}}},
+        // The commas are kept as fillers, the last one stays until the closing bracket so it is known as not done
+        {(uint8_t)Type::ARGUMENT_LIST, any, {{bit(Type::ASSIGNMENT) | bit(FILLER_COMMA), bit(Type::NAME)}}},
+        {(uint8_t)Type::LIST_LITERAL, any, {{valueExpression | bit(FILLER_COMMA), 0}}},
+    };
+
+    struct Row {
+        uint32_t arity; // 0 for anything that is not a phrase
+        Mask done[maxPositions];
+        Mask building[maxPositions];
+    };
+    struct Table {
+        Row rows[rowCount];
+    };
+    // The compile fails on a rule that doesn't fit its arity
+    constexpr Table buildTable() {
+        Table table{};
+        for (const Rule& rule : rules) {
+            Row& row = table.rows[rule.row];
+            if (row.arity != 0) throw "two rules for the same phrase";
+            row.arity = rule.arity;
+            const uint32_t written = rule.arity == any ? 1 : rule.arity;
+            if (written == 0 || written > maxPositions) throw "a phrase has more positions than the table";
+            for (uint32_t pos = 0; pos < maxPositions; ++pos) {
+                if (pos >= written && rule.positions[pos].accepts != 0) throw "a rule has more positions than its arity";
+                if (pos < written && rule.positions[pos].accepts == 0) throw "a rule takes nothing in one of its positions";
+                if (pos >= written && rule.arity != any) continue;
+                const Position& from = rule.positions[pos < written ? pos : 0];
+                row.done[pos] = from.accepts;
+                row.building[pos] = from.accepts | from.building;
+            }
+        }
+        return table;
+    }
+    inline constexpr Table table = buildTable();
+
+    constexpr uint8_t rowOf(Type type, Symbol symbol) {
+        if (type != Type::KEYWORD) return kindOf(type, symbol);
+        if (symbol < Symbol::CREATE || symbol > Symbol::OUTPUT) return (uint8_t)Type::UNSET;
+        return keywordRow(symbol);
+    }
 
-inline Token::Token(Token &token)
-    : type(token.type), value(token.value), line(token.line), pos(token.pos) {}
+    // Past the last position a list takes the same as at it
+    constexpr bool accepts(uint8_t row, uint8_t kind, uint32_t pos, bool final) {
+        const Row& phrase = table.rows[row];
+        if (pos >= phrase.arity) return false;
+        const uint32_t at = std::min(pos, maxPositions - 1);
+        return ((final ? phrase.done[at] : phrase.building[at]) >> kind) & 1;
+    }
+}
+
+static_assert(GrammarTable::table.rows[GrammarTable::keywordRow(Symbol::FOREACH)].arity == 5);
+static_assert(GrammarTable::accepts(GrammarTable::keywordRow(Symbol::COLORSET), (uint8_t)Token::TokenType::NAME, 2, false));
+static_assert(!GrammarTable::accepts(GrammarTable::keywordRow(Symbol::COLORSET), (uint8_t)Token::TokenType::NAME, 2, true));
+
+// Turning literal text into the machine values tokens hold, each gives false for text that is not a valid one
+namespace LiteralValue {
+    inline bool parseNumber(std::string_view text, bool &integer, int64_t &asInteger, double &asDouble) {
+        const char *end = text.data() + text.size();
+        if (text.find('.') == std::string_view::npos) {
+            auto [ptr, ec] = std::from_chars(text.data(), end, asInteger);
+            if (ec == std::errc() && ptr == end) {
+                integer = true;
+                return true;
+            }
+            // Too big for an int64_t, falls through to a double
+        }
+        auto [ptr, ec] = std::from_chars(text.data(), end, asDouble);
+        integer = false;
+        return ec == std::errc() && ptr == end && !text.empty();
+    }
+
+    // Without the hashtag, the short forms have each digit doubled and no alpha is opaque
+    inline bool parseColor(std::string_view hex, uint32_t &rgba) {
+        uint32_t digits = 0;
+        auto [ptr, ec] = std::from_chars(hex.data(), hex.data() + hex.size(), digits, 16);
+        if (ec != std::errc() || ptr != hex.data() + hex.size()) return false;
+        switch (hex.size()) {
+            case 3:
+            case 4: {
+                if (hex.size() == 3) digits = digits << 4 | 0xF;
+                rgba = 0;
+                for (int shift = 12; shift >= 0; shift -= 4) rgba = rgba << 8 | ((digits >> shift) & 0xF) * 0x11;
+                return true;
+            }
+            case 6:
+                rgba = digits << 8 | 0xFF;
+                return true;
+            case 8:
+                rgba = digits;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // The quote marks are already gone, strings are only decoded when something asks for the value
+    inline std::string decodeString(std::string_view contents) {
+        if (contents.find('\\') == std::string_view::npos) return std::string(contents);
+        std::string resolved;
+        resolved.reserve(contents.size());
+        for (size_t i = 0; i < contents.size(); ++i) {
+            if (contents[i] != '\\' || i + 1 == contents.size()) {
+                resolved += contents[i];
+                continue;
+            }
+            switch (contents[++i]) {
+                case 'n':
+                    resolved += '\n';
+                    break;
+                case 't':
+                    resolved += '\t';
+                    break;
+                case 'r':
+                    resolved += '\r';
+                    break;
+                case '\\':
+                case '"':
+                    resolved += contents[i];
+                    break;
+                default:
+                    // Not an escape, kept as it was written
+                    resolved += '\\';
+                    resolved += contents[i];
+                    break;
+            }
+        }
+        return resolved;
+    }
+}
+
+inline Token::Token() 
+    : type(Token::TokenType::UNSET), integer(0), length(0), offset(0), value{0} {}
 
 // A more complete string -> token built on top of the type from getLiteral()
-inline Token::Token(TokenType literalType, const std::string& value, const uint32_t& line,
-        const uint32_t& pos, bool first, bool inLink, bool inHtml) {
+inline Token::Token(TokenType literalType, std::string_view value, uint32_t offset,
+        bool first, bool inLink, bool inHtml) {
     type = literalType;
-    this->value = value;
-    this->line = line;
-    this->pos = pos;
+    integer = 0;
+    this->offset = offset;
+    length = (uint32_t)std::min<size_t>(value.size(), maxLength);
+    this->value.integer = 0;
+    // Literals are decoded here once, one that does not decode is left UNKNOWN with its text so it gets reported.
+            // Strings are not, their text can be anything so it stays behind the span instead of going into the table
     switch (literalType) {
-        case Token::TokenType::NAME:
-            if(inHtml) type = Token::TokenType::HTMLPART;
-            break;
         case Token::TokenType::STRING_LITERAL:
-            this->value = value.substr(1, value.size()-1);
+            return;
+        case Token::TokenType::BOOL_LITERAL:
+            this->value.flag = value == "true";
+            return;
+        case Token::TokenType::NUMERIC_LITERAL: {
+            bool isInteger = false;
+            int64_t asInteger = 0;
+            double asDouble = 0;
+            if (LiteralValue::parseNumber(value, isInteger, asInteger, asDouble)) {
+                integer = isInteger;
+                if (isInteger) this->value.integer = asInteger;
+                else this->value.number = asDouble;
+                return;
+            }
+            type = Token::TokenType::UNKNOWN;
             break;
+        }
         case Token::TokenType::COLOR_LITERAL:
-            this->value = value.substr(1);
+            if (LiteralValue::parseColor(value.substr(1), this->value.color)) return;
+            type = Token::TokenType::UNKNOWN;
+            break;
+        default:
+            break;
+    }
+    // Only names and paths are kept in the table, everything else is one of the fixed symbols or stays behind its span,
+            // otherwise every bit of broken text typed in the editor would be kept for good
+    if (type == Token::TokenType::NAME || type == Token::TokenType::FILE_LITERAL) this->value.symbol = SymbolTable::global().intern(value);
+    else if (Symbol known = SymbolTable::global().find(value); known < Symbol::PREDEFINED) this->value.symbol = known;
+    switch (type) {
+        case Token::TokenType::NAME:
+            if(inHtml) type = Token::TokenType::HTMLPART;
             break;
         case Token::TokenType::UNKNOWN:
             // Multichars and strings checked separately
-            if (value == "≥" || value == "≤" || value == "≠" || value == "≈")
-                type = Token::TokenType::BINARY_OPERATOR;
-            else if (value == "xor" || value == "and" || value == "or")
-                type = Token::TokenType::BINARY_OPERATOR;
-            else if (value == "not")
-                type = Token::TokenType::UNARY_OPERATOR;
-            else if (value.size() == 1) switch (value[0]) {
-                case '+':
-                case '-':
+            switch (this->value.symbol) {
+                case Symbol::GREATER_EQUAL:
+                case Symbol::LESS_EQUAL:
+                case Symbol::NOT_EQUAL:
+                case Symbol::APPROX:
+                case Symbol::XOR:
+                case Symbol::AND:
+                case Symbol::OR:
+                    type = Token::TokenType::BINARY_OPERATOR;
+                    break;
+                case Symbol::NOT:
+                    type = Token::TokenType::UNARY_OPERATOR;
+                    break;
+                case Symbol::PLUS:
+                case Symbol::MINUS:
                     type = first ? Token::TokenType::UNARY_OPERATOR :
                         Token::TokenType::BINARY_OPERATOR;
                     break;
-                case '/':
+                case Symbol::SLASH:
                     type = (first && inLink) ? Token::TokenType::UNARY_OPERATOR :
                         Token::TokenType::BINARY_OPERATOR;
                     break;
-                case '*':
-                case '%':
-                case '&':
-                case '|':
-                case '^':
-                case '<':
-                case '>':
+                case Symbol::STAR:
+                case Symbol::PERCENT:
+                case Symbol::AMPERSAND:
+                case Symbol::PIPE:
+                case Symbol::CARET:
+                case Symbol::LESS:
+                case Symbol::GREATER:
                     type = Token::TokenType::BINARY_OPERATOR;
                     break;
-                case '!':
-                    this->value = "not";
+                case Symbol::BANG:
+                    this->value.symbol = Symbol::NOT;
                     [[fallthrough]];
-                case '~':
+                case Symbol::TILDE:
                     type = Token::TokenType::UNARY_OPERATOR;
                     break;
-                case '=':
+                case Symbol::ASSIGN:
                     type = Token::TokenType::ASSIGNMENT;
                     break;
-                case '[':
+                case Symbol::OPEN_SQUARE:
                     type = Token::TokenType::LIST_LITERAL;
                     break;
-                case '(':
+                case Symbol::OPEN_PAREN:
                     type = Token::TokenType::UNARY_OPERATOR;
                     // brackets used for math can be treated as a unary operator that does nothing,
                     // argument lists aren't detected here
                     break;
-                case ']':
-                case ')':
+                case Symbol::CLOSE_SQUARE:
+                case Symbol::CLOSE_PAREN:
                     type = Token::TokenType::FILLER;
                     break;
+                default:
+                    break;
                 }
             break;
         default:
@@ -179,280 +494,372 @@ inline Token::Token(TokenType literalType, const std::string& value, const uint3
     }
 }
 
-inline Token::Token(TokenType type, const std::string& value, const uint32_t& line, const uint32_t& pos) 
-    : type(type), value(value), line(line), pos(pos) {}
+inline Token::Token(TokenType type, Symbol value, uint32_t offset, uint32_t length) 
+    : type(type), integer(0), length(std::min(length, maxLength)), offset(offset), value{0} {
+    this->value.symbol = value;
+}
 
-inline Token& Token::operator=(const Token& other) {
-    if (this == &other) return *this;
+inline Token::TokenType Token::getType() const {
+    return type;
+}
 
-    type = other.type;
-    value = other.value;
-    line = other.line;
-    pos = other.pos;
+inline Symbol Token::getSymbol() const {
+    return holdsSymbol(type) ? value.symbol : Symbol::EMPTY;
+}
 
-    return *this;
+inline std::string_view Token::getValue() const {
+    return SymbolTable::global().getText(getSymbol());
 }
 
-inline Token::TokenType Token::getType() const {
-    return type;
+inline void Token::setSymbol(Symbol symbol) {
+    value.integer = 0;
+    value.symbol = symbol;
 }
 
-inline const std::string& Token::getValue() const {
-    return value;
+inline void Token::setValue(Symbol value) {
+    setSymbol(value);
 }
 
-inline void Token::setValue(const std::string& value) {
-    this->value = value;
+inline void Token::setValue(std::string_view value) {
+    setSymbol(SymbolTable::global().intern(value));
 }
 
-inline const uint32_t& Token::getLine() const {
-    return line;
+inline bool Token::isInteger() const {
+    return integer;
 }
 
-inline const uint32_t& Token::getPos() const {
-    return pos;
+inline int64_t Token::getInteger() const {
+    return integer ? value.integer : (int64_t)value.number;
 }
 
-inline uint32_t Token::getPhraseLength(Token kw) {
-    switch (kw.type) {
-        case Token::TokenType::KEYWORD:
-            switch (str2int(kw.value.c_str())) {
-                case str2int("create"):
-                    return 1; // Create takes in an htmlpart or binary '('
-                case str2int("open"):
-                case str2int("file"):
-                    return 1; // Open & File takes in a file literal
-                case str2int("colorset"):
-                    return 3; // Color set takes in 3 assignments
-                case str2int("foreach"):
-                    return 5; // For each takes in a variable name, then a filler in word, then a value expression,
-                                        // then a filler do keyword, then a full phrase
-                case str2int("using"):
-                    return 5; // Using takes in a value expression, then a filler as word, then a variable name,
-                                        // then a filler do keyword, then a full phrase
-                case str2int("export"):
-                #ifdef Ver0_1_0
-                case str2int("output"):
-                #endif
-                    return 1; // Export & Output takes in a value expression
-                default:
-                    return 0;
-            }
-        case Token::TokenType::ASSIGNMENT:
-            return 2;
-        case Token::TokenType::BINARY_OPERATOR:
-            return 2;
-        case Token::TokenType::UNARY_OPERATOR:
-            return 1;
-        case Token::TokenType::CONST:
-            return 1;
-        case Token::TokenType::ARGUMENT_LIST:
-            return -1;  // -1 (the uint32_t max) represents variable length
-        case Token::TokenType::LIST_LITERAL:
-            return -1;
+inline double Token::getNumber() const {
+    return integer ? (double)value.integer : value.number;
+}
+
+inline uint32_t Token::getColor() const {
+    return value.color;
+}
+
+inline bool Token::getBool() const {
+    return value.flag;
+}
+
+inline bool Token::hasSameValue(Token other) const {
+    return integer == other.integer && value.integer == other.value.integer;
+}
+
+inline std::string Token::getValueText(std::string_view text) const {
+    switch (type) {
+        case Token::TokenType::STRING_LITERAL:
+            return text.size() >= 2 ? LiteralValue::decodeString(text.substr(1, text.size() - 2)) : std::string();
+        case Token::TokenType::BOOL_LITERAL:
+            return value.flag ? "true" : "false";
+        case Token::TokenType::NUMERIC_LITERAL: {
+            char buffer[32];
+            char *end = integer ? std::to_chars(buffer, buffer + sizeof(buffer), value.integer).ptr
+                    : std::to_chars(buffer, buffer + sizeof(buffer), value.number).ptr;
+            return std::string(buffer, end);
+        }
+        case Token::TokenType::COLOR_LITERAL: {
+            std::string text = "#00000000";
+            for (int digit = 0; digit < 8; ++digit) text[8 - digit] = "0123456789abcdef"[(value.color >> (digit * 4)) & 0xF];
+            return text;
+        }
         default:
-            return 0;
+            return getSymbol() == Symbol::EMPTY ? std::string(text) : std::string(getValue());
     }
 }
 
+inline uint32_t Token::getOffset() const {
+    return offset;
+}
+
+inline void Token::setOffset(uint32_t offset) {
+    this->offset = offset;
+}
+
+inline uint32_t Token::getLength() const {
+    return length;
+}
+
+inline uint32_t Token::getPhraseLength(Token kw) {
+    return GrammarTable::table.rows[GrammarTable::rowOf(kw.type, kw.value.symbol)].arity;
+}
+
 inline bool Token::doesAcceptInPosition(Token kw, Token t, uint32_t pos, bool final) {
     // Some stuff changes during construction, like assignments are built up with the name first,
                                 // so there is a difference between final and not
-    switch (kw.type) {
-    case Token::TokenType::KEYWORD:
-            switch (str2int(kw.value.c_str())) {
-                case str2int("create"):
-                    // Create takes in an htmlpart or binary '('
-                    if (pos == 0) return t.type == Token::TokenType::HTMLPART ||
-                        (t.type == Token::TokenType::BINARY_OPERATOR && t.value == "(");
-                    return false;
-                case str2int("open"):
-                case str2int("file"):
-                    // Open & File takes in a file literal
-                    return t.type == Token::TokenType::FILE_LITERAL && pos == 0;
-                case str2int("colorset"):
-                    // Color set takes in 3 assignments
-                    if (pos > 2) return false;
-                    if (t.type == Token::TokenType::ASSIGNMENT) return true;
-                    if (t.type == Token::TokenType::NAME) return !final;
-                    return false;
-                case str2int("foreach"):
-                    // For each takes in a variable name, then a filler in word, then a value expression,
-                                        // then a filler do keyword, then a full phrase
-                    switch (pos) {
-                        case 0:
-                            return t.type == Token::TokenType::NAME;
-                        case 1:
-                            return t.type == Token::TokenType::FILLER && t.value == "in";
-                        case 2:
-                            return isValueExpression(t);
-                        case 3:
-                            return t.type == Token::TokenType::FILLER && t.value == "do";
-                        case 4:
-                            return isFullPhrase(t);
-                        default:
-                            return false;
-                    }
-                case str2int("using"):
-                    // Using takes in a value expression, then a filler as word, then a variable name,
-                                        // then a filler do keyword, then a full phrase
-                    switch (pos) {
-                        case 0:
-                            return isValueExpression(t);
-                        case 1:
-                            return t.type == Token::TokenType::FILLER && t.value == "as";
-                        case 2:
-                            return t.type == Token::TokenType::NAME;
-                        case 3:
-                            return t.type == Token::TokenType::FILLER && t.value == "do";
-                        case 4:
-                            return isFullPhrase(t);
-                        default:
-                            return false;
-                    }
-                case str2int("export"):
-                #ifdef Ver0_1_0
-                case str2int("output"):
-                #endif
-                    // Export & Output takes in a value expression
-                    return isValueExpression(t) && pos == 0;
-                default:
-                    return 0;
-            }
-        case Token::TokenType::ASSIGNMENT:
-            if (pos == 1) return isValueExpression(t);
-            if (pos == 0) return t.type == Token::TokenType::NAME;
-            return false;
-        case Token::TokenType::BINARY_OPERATOR:
-            if (kw.value == "(") {
-                if (pos == 1) return t.type == Token::TokenType::ARGUMENT_LIST;
-                if (pos == 0) return isValueExpression(t) || t.type == Token::TokenType::HTMLPART;
-                return false;
-            }
-            return isValueExpression(t) && (pos == 0 || pos == 1);
-        case Token::TokenType::UNARY_OPERATOR:
-            return isValueExpression(t) && pos == 0;
-        case Token::TokenType::CONST:
-            if (pos != 0) return false;
-            if (t.type == Token::TokenType::ASSIGNMENT) return true;
-            if (t.type == Token::TokenType::NAME) return !final;
-            return false;
-        case Token::TokenType::ARGUMENT_LIST:
-            if (t.type == Token::TokenType::ASSIGNMENT) return true;
-            if (t.type == Token::TokenType::NAME) return !final;
-            if (t.type == Token::TokenType::FILLER) return t.value == ",";
-            return false;
-        case Token::TokenType::LIST_LITERAL:
-            if (isValueExpression(t)) return true;
-            if (t.type == Token::TokenType::NAME) return !final;
-            if (t.type == Token::TokenType::FILLER) return t.value == ",";
-            return false;
-        default:
-            return false;
-    }
+    return GrammarTable::accepts(GrammarTable::rowOf(kw.type, kw.value.symbol),
+            GrammarTable::kindOf(t.type, t.value.symbol), pos, final);
 }
 
 inline bool Token::isPureValueExpression(Token t) {
-    switch (t.type) {
-        case Token::TokenType::NAME:
-        case Token::TokenType::STRING_LITERAL:
-        case Token::TokenType::BOOL_LITERAL:
-        case Token::TokenType::NUMERIC_LITERAL:
-        case Token::TokenType::THIS_LITERAL:
-        case Token::TokenType::COLOR_LITERAL:
-        case Token::TokenType::LIST_LITERAL:
-        case Token::TokenType::UNARY_OPERATOR:
-        case Token::TokenType::BINARY_OPERATOR:
-            return true;
-        default:
-            return false;
-    }
+    return GrammarTable::pureValueExpression & GrammarTable::bit(t.type);
 }
 
 inline bool Token::isValueExpression(Token t) {
-    return isPureValueExpression(t) || (t.type == Token::TokenType::KEYWORD);
+    return GrammarTable::valueExpression & GrammarTable::bit(t.type);
 }
 
 inline bool Token::isFullPhrase(Token t) {
-    return isValueExpression(t) || (t.type == Token::TokenType::CONST);
+    return GrammarTable::fullPhrase & GrammarTable::bit(t.type);
 }
 
 inline bool Token::isPhrase(Token t) {
-    switch(t.type) {
-        case Token::TokenType::CONST:
-        case Token::TokenType::KEYWORD:
+    return GrammarTable::phrase & GrammarTable::bit(t.type);
+}
+
+inline uint8_t Token::getPrecedence(Token t) {
+    // Loosest first, in the same order as Python
+    enum Level : uint8_t {
+        NONE,
+        ASSIGNING, // The '=' of a const or argument
+        EITHER, // or ||
+        EXCLUSIVE, // ^^
+        BOTH, // and &&
+        NEGATION, // not !
+        COMPARISON, // = == != ~= < > <= >= and their single character forms
+        BIT_OR, // |
+        BIT_XOR, // ^
+        BIT_AND, // &
+        SUM, // + -
+        PRODUCT, // * / // %
+        SIGN, // Unary + - ~
+        EXPONENT, // **
+        CALL // The binary '(' of an argument list
+    };
+    switch (t.type) {
         case Token::TokenType::ASSIGNMENT:
-        case Token::TokenType::ARGUMENT_LIST:
-        case Token::TokenType::LIST_LITERAL:
+            return ASSIGNING;
         case Token::TokenType::UNARY_OPERATOR:
+            switch (t.value.symbol) {
+                case Symbol::NOT:
+                    return NEGATION;
+                case Symbol::PLUS:
+                case Symbol::MINUS:
+                case Symbol::TILDE:
+                    return SIGN;
+                default:
+                    return NONE; // A bracket is a whole value once it is closed
+            }
         case Token::TokenType::BINARY_OPERATOR:
-            return true;
+            switch (t.value.symbol) {
+                case Symbol::OR:
+                    return EITHER;
+                case Symbol::XOR:
+                    return EXCLUSIVE;
+                case Symbol::AND:
+                    return BOTH;
+                case Symbol::ASSIGN:
+                case Symbol::EQUALS:
+                case Symbol::NOT_EQUAL:
+                case Symbol::APPROX:
+                case Symbol::LESS:
+                case Symbol::GREATER:
+                case Symbol::LESS_EQUAL:
+                case Symbol::GREATER_EQUAL:
+                    return COMPARISON;
+                case Symbol::PIPE:
+                    return BIT_OR;
+                case Symbol::CARET:
+                    return BIT_XOR;
+                case Symbol::AMPERSAND:
+                    return BIT_AND;
+                case Symbol::PLUS:
+                case Symbol::MINUS:
+                    return SUM;
+                case Symbol::STAR:
+                case Symbol::SLASH:
+                case Symbol::DOUBLE_SLASH:
+                case Symbol::PERCENT:
+                    return PRODUCT;
+                case Symbol::POWER:
+                    return EXPONENT;
+                case Symbol::OPEN_PAREN:
+                    return CALL;
+                default:
+                    return NONE;
+            }
+        default:
+            return NONE;
+    }
+}
+
+inline bool Token::isRightAssociative(Token t) {
+    return t.type == Token::TokenType::BINARY_OPERATOR && t.value.symbol == Symbol::POWER;
+}
+
+inline Symbol Token::getCompound(Token t, std::string_view next) {
+    if (next.size() != 1) return Symbol::EMPTY;
+    const bool binary = t.type == Token::TokenType::BINARY_OPERATOR, unary = t.type == Token::TokenType::UNARY_OPERATOR;
+    // Each can only be followed by one character, '=' or itself
+    Symbol made = Symbol::EMPTY;
+    char with = '=';
+    switch (t.value.symbol) {
+        case Symbol::ASSIGN:
+            if (binary || t.type == Token::TokenType::ASSIGNMENT) made = Symbol::EQUALS;
+            break;
+        case Symbol::LESS:
+            if (binary) made = Symbol::LESS_EQUAL;
+            break;
+        case Symbol::GREATER:
+            if (binary) made = Symbol::GREATER_EQUAL;
+            break;
+        case Symbol::NOT:
+            if (unary) made = Symbol::NOT_EQUAL;
+            break;
+        case Symbol::TILDE:
+            if (unary) made = Symbol::APPROX;
+            break;
+        case Symbol::STAR:
+            if (binary) made = Symbol::POWER, with = '*';
+            break;
+        case Symbol::SLASH:
+            if (binary) made = Symbol::DOUBLE_SLASH, with = '/';
+            break;
+        case Symbol::CARET:
+            if (binary) made = Symbol::XOR, with = '^';
+            break;
+        case Symbol::AMPERSAND:
+            if (binary) made = Symbol::AND, with = '&';
+            break;
+        case Symbol::PIPE:
+            if (binary) made = Symbol::OR, with = '|';
+            break;
         default:
-            return false;
+            break;
     }
+    return next[0] == with ? made : Symbol::EMPTY;
 }
 
+// Tables for getLiteral(), built at compile time
+namespace LiteralTable {
+    struct Entry {
+        std::string_view word;
+        Token::TokenType type;
+    };
+
+    // Every word getLiteral() gives a type to by name, the rest are worked out from their characters
+    inline constexpr Entry words[] = {
+        {"true", Token::TokenType::BOOL_LITERAL},
+        {"false", Token::TokenType::BOOL_LITERAL},
+        {"this", Token::TokenType::THIS_LITERAL},
+        {"const", Token::TokenType::CONST},
+        {"create", Token::TokenType::KEYWORD},
+        {"open", Token::TokenType::KEYWORD},
+        {"file", Token::TokenType::KEYWORD},
+        {"colorset", Token::TokenType::KEYWORD},
+        {"foreach", Token::TokenType::KEYWORD},
+        {"using", Token::TokenType::KEYWORD},
+        {"export", Token::TokenType::KEYWORD},
+        #ifdef Ver0_1_0
+        {"output", Token::TokenType::KEYWORD},
+        #endif
+        {"as", Token::TokenType::FILLER},
+        {"in", Token::TokenType::FILLER},
+        {"do", Token::TokenType::FILLER},
+        {",", Token::TokenType::FILLER},
+        // Word operators, the token constructor sorts out which kind
+        {"xor", Token::TokenType::UNKNOWN},
+        {"and", Token::TokenType::UNKNOWN},
+        {"or", Token::TokenType::UNKNOWN},
+        {"not", Token::TokenType::UNKNOWN},
+    };
+
+    // No two words share their first character, last character and length, so only those are hashed, word can not be empty
+    constexpr uint32_t key(std::string_view word) {
+        return (uint32_t)(uint8_t)word.front() | (uint32_t)(uint8_t)word.back() << 8 | (uint32_t)word.size() << 16;
+    }
+
+    constexpr uint32_t slotBits = 6;
+    constexpr uint32_t slot(uint32_t key, uint32_t seed) {
+        return (key * seed) >> (32 - slotBits);
+    }
+
+    // The first multiplier that gives every word a slot of its own, the compile fails if a new word can't get one
+    constexpr uint32_t findSeed() {
+        for (uint32_t seed = 0x9E3779B1u; seed < 0x9E3779B1u + (1u << 20); seed += 2) {
+            bool used[1 << slotBits] = {};
+            bool perfect = true;
+            for (const Entry& entry : words) {
+                uint32_t s = slot(key(entry.word), seed);
+                if (used[s]) {
+                    perfect = false;
+                    break;
+                }
+                used[s] = true;
+            }
+            if (perfect) return seed;
+        }
+        throw "no perfect hash for the literal words";
+    }
+    inline constexpr uint32_t seed = findSeed();
+
+    struct Slots {
+        Entry entries[1 << slotBits];
+    };
+    constexpr Slots buildSlots() {
+        Slots slots{};
+        for (const Entry& entry : words) slots.entries[slot(key(entry.word), seed)] = entry;
+        return slots;
+    }
+    inline constexpr Slots slots = buildSlots();
+
+    // The hash only narrows it down to one word, the word itself still has to match
+    constexpr const Entry* find(std::string_view word) {
+        // Nothing to take the first and last character of, and no word is empty anyway
+        if (word.empty()) return nullptr;
+        const Entry& entry = slots.entries[slot(key(word), seed)];
+        return entry.word == word ? &entry : nullptr;
+    }
+
+    // What each byte can be part of, a token is classified by and-ing these together
+    enum CharClass : uint8_t {
+        NUMERIC = 1, // 0-9, .
+        HEX = 2, // 0-9, a-f, A-F
+        WORD = 4, // 0-9, a-z, A-Z, _
+        LINK_WORD = 8 // Words in links can have .'s too
+    };
+    constexpr std::array<uint8_t, 256> buildCharClasses() {
+        std::array<uint8_t, 256> classes{};
+        for (int c = '0'; c <= '9'; ++c) classes[c] = NUMERIC | HEX | WORD | LINK_WORD;
+        for (int c = 'a'; c <= 'z'; ++c) classes[c] = WORD | LINK_WORD | (c <= 'f' ? HEX : 0);
+        for (int c = 'A'; c <= 'Z'; ++c) classes[c] = WORD | LINK_WORD | (c <= 'F' ? HEX : 0);
+        classes['_'] = WORD | LINK_WORD;
+        classes['.'] = NUMERIC | LINK_WORD;
+        return classes;
+    }
+    inline constexpr std::array<uint8_t, 256> charClasses = buildCharClasses();
+}
+
+static_assert(LiteralTable::find("colorset")->type == Token::TokenType::KEYWORD);
+static_assert(LiteralTable::find("colorsex") == nullptr);
+static_assert(LiteralTable::find("") == nullptr);
+
 // Not full type resolution! Just the following:
 // Const, StringLiteral, BoolLiteral, ThisLiteral, ColorLiteral,
 // NumericLiteral, Keyword, Filler words, Name (possibly), or Unknown
 // If expecting a file literal it will include .'s and give
 // FileLiteral instead of Name, but it won't do that elsewise
-inline Token::TokenType Token::getLiteral(std::string token, bool inLink) {
-    if (token.front() == '"' && token.back() == '"')
+inline Token::TokenType Token::getLiteral(std::string_view token, bool inLink) {
+    if (token.empty())
+        return Token::TokenType::UNKNOWN;
+    if (token.size() >= 2 && token.front() == '"' && token.back() == '"' && !ByteScan::isEscaped(token, token.size() - 1))
         return Token::TokenType::STRING_LITERAL;
-    switch (str2int(token.c_str())) {
-        case str2int("true"):
-        case str2int("false"):
-            return Token::TokenType::BOOL_LITERAL;
-        case str2int("this"):
-            return Token::TokenType::THIS_LITERAL;
-        case str2int("const"):
-            return Token::TokenType::CONST;
-        case str2int("create"):
-        case str2int("open"):
-        case str2int("file"):
-        case str2int("colorset"):
-        case str2int("foreach"):
-        case str2int("using"):
-        case str2int("export"):
-        #ifdef Ver0_1_0
-        case str2int("output"):
-        #endif
-            return Token::TokenType::KEYWORD;
-        case str2int("as"):
-        case str2int("in"):
-        case str2int("do"):
-        case str2int(","):
-            return Token::TokenType::FILLER;
-        case str2int("xor"):
-        case str2int("and"):
-        case str2int("or"):
-        case str2int("not"):
-            return Token::TokenType::UNKNOWN;
-    };
+    if (const LiteralTable::Entry *entry = LiteralTable::find(token))
+        return entry->type;
 
-    bool alphanumeric = true, numeric = true, hex = true, first = true;
+    // One pass over the bytes, stopping early once nothing is left that the token could be
     const bool hashtag = token.front() == '#';
-    for (char c : token) {
-        if(first && hashtag) {
-            first = false;
-            continue;
-        }
-        // Numbers can be made of 0-9, .
-        if (!isdigit(c) && c != '.')
-            numeric = false;
-        // Hex can be made of 0-9, a-f, A-F
-        if (!isxdigit(c))
-            hex = false;
-        // Words can be made of 0-9, a-z, A-Z, _, inLink: .
-        if (!isalnum(c) && c != '_' && (!inLink || c != '.'))
-            alphanumeric = false; 
-    }
+    uint8_t classes = LiteralTable::NUMERIC | LiteralTable::HEX | LiteralTable::WORD | LiteralTable::LINK_WORD;
+    for (size_t i = hashtag ? 1 : 0; i < token.size() && classes != 0; ++i)
+        classes &= LiteralTable::charClasses[(uint8_t)token[i]];
+
     if (hashtag)
-        return hex ? Token::TokenType::COLOR_LITERAL : Token::TokenType::UNKNOWN;
-    if (numeric)
+        return (classes & LiteralTable::HEX) ? Token::TokenType::COLOR_LITERAL : Token::TokenType::UNKNOWN;
+    if (classes & LiteralTable::NUMERIC)
         return Token::TokenType::NUMERIC_LITERAL;
-    if (alphanumeric)
+    if (classes & (inLink ? LiteralTable::LINK_WORD : LiteralTable::WORD))
         return inLink ? Token::TokenType::FILE_LITERAL : Token::TokenType::NAME;
     return Token::TokenType::UNKNOWN;
 }
@@ -3,80 +3,309 @@ PURPOSE:
 - Converts raw text into digestable tokens for compilation
 */
 #include "tokenparser.h"
-#include <sstream>
+#include "bytescan.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// How many continuation bytes follow the lead byte at i, 0 when it is not the start of a whole character so it stands alone
+size_t utf8Continuations(std::string_view text, size_t i) {
+    const uint8_t lead = text[i];
+    const size_t count = lead >= 0xC2 && lead <= 0xDF ? 1 : lead >= 0xE0 && lead <= 0xEF ? 2 : lead >= 0xF0 && lead <= 0xF4 ? 3 : 0;
+    if (i + count >= text.size()) return 0;
+    // Only some second bytes make a real character after these leads, the rest would be overlong, a surrogate or past U+10FFFF
+    const uint8_t second = text[i + 1];
+    const uint8_t low = lead == 0xE0 ? 0xA0 : lead == 0xF0 ? 0x90 : 0x80;
+    const uint8_t high = lead == 0xED ? 0x9F : lead == 0xF4 ? 0x8F : 0xBF;
+    if (count != 0 && (second < low || second > high)) return 0;
+    for (size_t c = 2; c <= count; ++c)
+        if (((uint8_t)text[i + c] & 0xC0) != 0x80) return 0;
+    return count;
+}
+
+// One piece of text for parallel lexing, it starts just after a line break so it can only start in a string or not
+struct Piece {
+    uint32_t start, end;
+    bool startsInString = false; // How it was lexed, at first as if it did not
+    std::vector<LexToken> tokens;
+    LexState endState;
+    bool stringGuessEnds = false; // Whether it would end in a string if it started in one
+};
+
+// Where a piece starts is the only thing about it that depends on the pieces before it
+LexState pieceStart(uint32_t start, bool inString) {
+    LexState state;
+    state.offset = start;
+    state.previous = '\n';
+    if (inString) {
+        // Stands in for wherever the string really started, which is only known once the pieces before are done
+        state.inString = true;
+        state.tokenStart = start;
+        state.kind = LexToken::Kind::STRING;
+    }
+    return state;
+}
+
+void lexPiece(std::string_view text, Piece &piece) {
+    const std::string_view chunk = text.substr(piece.start, piece.end - piece.start);
+    piece.tokens.clear();
+    piece.tokens.reserve(chunk.size() / 4);
+    LexState state = pieceStart(piece.start, piece.startsInString);
+    TokenParser::lexChunk(chunk, state, piece.tokens);
+    piece.endState = state;
+}
+
+// Only follows strings and comments, which is all the lexer needs to know whether it ends in a string
+bool endsInString(std::string_view chunk, bool inString) {
+    for (size_t i = 0; i < chunk.size(); ) {
+        if (inString) {
+            i = chunk.find('"', i);
+            if (i == std::string_view::npos) return true;
+            // An escaped quote carries on with the string
+            inString = ByteScan::isEscaped(chunk, i);
+            ++i;
+            continue;
+        }
+        while (i < chunk.size() && chunk[i] != '"' && chunk[i] != '/') ++i;
+        if (i == chunk.size()) break;
+        if (chunk[i] == '"') inString = true;
+        else if (i + 1 < chunk.size() && chunk[i + 1] == '/') {
+            i = chunk.find('\n', i + 2);
+            if (i == std::string_view::npos) break;
+        }
+        ++i;
+    }
+    return inString;
+}
+
+}
 
 TokenParser::TokenParser() {}
 
-std::vector<std::tuple<std::string, uint32_t, uint32_t>> TokenParser::parse(const std::string& text) {
+void TokenParser::setParallelThreshold(size_t bytes) {
+    parallelThreshold = bytes;
+}
+
+void TokenParser::setThreads(unsigned threads) {
+    this->threads = threads;
+}
+
+const std::vector<LexToken>& TokenParser::lex(std::string_view text) {
     tokenize(text);
     return tokens;
 }
 
-std::vector<std::tuple<std::string, uint32_t, uint32_t>> TokenParser::getTokens() const {
+const std::vector<LexToken>& TokenParser::getTokens() const {
     return tokens;
 }
 
-void TokenParser::tokenize(const std::string& text) {
+std::vector<std::tuple<std::string, uint32_t>> TokenParser::parse(const std::string& text) {
+    tokenize(text);
+    std::vector<std::tuple<std::string, uint32_t>> copies;
+    copies.reserve(tokens.size());
+    for (const LexToken& token : tokens)
+        copies.emplace_back(std::string(token.text(text)), token.offset);
+    return copies;
+}
+
+void TokenParser::tokenize(std::string_view text) {
+    const unsigned pieces = threads != 0 ? threads : std::thread::hardware_concurrency();
+    if (parallelThreshold != 0 && text.size() >= parallelThreshold && pieces > 1) {
+        tokenizeParallel(text, pieces);
+        return;
+    }
     tokens.clear();
-    std::string currentToken;
-    bool inString = false;
-    bool inComment = false;
-    uint32_t line = 0, pos = 0;
-    
-    for (size_t i = 0; i < text.length(); ++i) {
-        char currentChar = text[i];
-        if(currentChar == '\n') {
-            ++line;
-            pos = 0;
-        } else ++pos;
+    // Rough guess so the vector does not keep reallocating on big files
+    tokens.reserve(text.length() / 4);
+    LexState state;
+    lexChunk(text, state, tokens);
+    lexFinish(state, tokens);
+}
+
+void TokenParser::tokenizeParallel(std::string_view text, unsigned count) {
+    // Split into about even pieces, each moved on to just after a line break, a piece that would be empty is dropped
+    std::vector<Piece> pieces;
+    uint32_t start = 0;
+    for (unsigned i = 1; i <= count && start < text.size(); ++i) {
+        size_t end = i == count ? text.size() : text.find('\n', std::max<size_t>(start, text.size() / count * i));
+        end = end == std::string_view::npos ? text.size() : end + (i < count);
+        pieces.emplace_back();
+        pieces.back().start = start;
+        pieces.back().end = (uint32_t)end;
+        start = (uint32_t)end;
+    }
+
+    auto forEachPiece = [&](auto work) {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < pieces.size(); ++i) workers.emplace_back(work, i);
+        work(0);
+        for (std::thread &worker : workers) worker.join();
+    };
+    // Lexed as if it starts outside a string, and only followed far enough to know how it would end if it started in one
+    forEachPiece([&](size_t i) {
+        lexPiece(text, pieces[i]);
+        pieces[i].stringGuessEnds = endsInString(text.substr(pieces[i].start, pieces[i].end - pieces[i].start), true);
+    });
+
+    // Now each piece's real start follows from the end of the one before, in order, and any guessed wrong are lexed again
+    bool inString = false, wrong = false;
+    for (Piece &piece : pieces) {
+        const bool endsIn = inString ? piece.stringGuessEnds : piece.endState.inString;
+        piece.startsInString = inString;
+        wrong = wrong || inString;
+        inString = endsIn;
+    }
+    if (wrong) forEachPiece([&](size_t i) {
+        if (pieces[i].startsInString) lexPiece(text, pieces[i]);
+    });
+
+    struct Resolved {
+        uint32_t openStart; // Where the string it starts in began
+        size_t first; // Where its tokens go in the output
+    };
+    std::vector<Resolved> resolved(pieces.size());
+    uint32_t openStart = 0;
+    size_t total = 0;
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        const Piece &piece = pieces[i];
+        resolved[i] = {openStart, total};
+        total += piece.tokens.size();
+        // A string that never closed still stands in for the one that started before this piece
+        if (piece.endState.inString && !(piece.startsInString && piece.endState.tokenStart == piece.start))
+            openStart = piece.endState.tokenStart;
+    }
+
+    tokens.resize(total);
+    forEachPiece([&](size_t i) {
+        const Piece &piece = pieces[i];
+        const Resolved &real = resolved[i];
+        LexToken *out = tokens.data() + real.first;
+        std::copy(piece.tokens.begin(), piece.tokens.end(), out);
+        // Starting in a string the first token is where it closes, it really began back at openStart
+        if (piece.startsInString && !piece.tokens.empty()) {
+            out->length += out->offset - real.openStart;
+            out->offset = real.openStart;
+        }
+    });
+
+    // Only the last piece can end partway through a token
+    const Piece &last = pieces.back();
+    LexState end = last.endState;
+    if (last.startsInString && end.inString && end.tokenStart == last.start) end.tokenStart = openStart;
+    lexFinish(end, tokens);
+}
+
+LexCursor::LexCursor(std::string_view text) : text(text) {
+    window.reserve(windowBytes / 2);
+}
+
+bool LexCursor::next(LexToken& token) {
+    while (index == window.size()) {
+        if (finished) return false;
+        window.clear();
+        index = 0;
+        if (state.offset == text.size()) {
+            TokenParser::lexFinish(state, window);
+            finished = true;
+            continue;
+        }
+        size_t end = text.find('\n', std::min<size_t>(state.offset + windowBytes, text.size()));
+        end = end == std::string_view::npos ? text.size() : end + 1;
+        TokenParser::lexChunk(text.substr(state.offset, end - state.offset), state, window);
+    }
+    token = window[index++];
+    return true;
+}
+
+void TokenParser::lexChunk(std::string_view chunk, LexState& state, std::vector<LexToken>& out) {
+    // Work on locals so the loop is not going through memory for every character
+    constexpr uint32_t none = LexState::none;
+    const uint32_t base = state.offset;
+    uint32_t tokenStart = state.tokenStart; // Start of the token being built, if there is one
+    LexToken::Kind kind = state.kind;
+    bool inString = state.inString;
+    bool inComment = state.inComment;
+
+    auto push = [&](uint32_t start, uint32_t end, LexToken::Kind kind) {
+        out.push_back(LexToken{start, end - start, kind});
+    };
+
+    for (size_t i = 0; i < chunk.length(); ++i) {
+        char currentChar = chunk[i];
+        const uint32_t offset = base + (uint32_t)i;
 
         // Check if we are inside a comment
         if (inComment) {
             if (currentChar == '\n') inComment = false;
+            else i = ByteScan::skipUntil(chunk, i + 1, '\n') - 1;
             continue;
         }
 
         // Check if we are inside a string
         if (inString) {
-            currentToken += currentChar;
-            if (currentChar == '"') {
+            // A quote after an odd run of backslashes is part of the string, see <escaped_quote> in language.ebns
+            if (currentChar == '"' && !ByteScan::isEscaped(chunk, i)) {
                 inString = false;
-                tokens.push_back(std::make_tuple(currentToken, line, pos));
-                currentToken.clear();
-            }
+                push(tokenStart, offset + 1, kind);
+                tokenStart = none;
+            } else i = ByteScan::skipUntil(chunk, i + 1, '"') - 1;
             continue;
         }
 
         // Check for the start of a comment
-        if (currentChar == '/' && i>0 && text[i-1] == '/') {
+        if (currentChar == '/' && (i > 0 ? chunk[i-1] : state.previous) == '/') {
             // We check the second one, so that the last token being cleared is already handled for us by the first slash
             inComment = true;
-            tokens.pop_back(); // There would have been a '/' added otherwise from the first one
+            out.pop_back(); // There would have been a '/' added otherwise from the first one
             continue;
         }
 
         // Check for the start of a string
         if (currentChar == '"') {
             inString = true;
-            currentToken += currentChar; // Include the starting quote
+            // Include the starting quote, anything already in the token stays part of it
+            if (tokenStart == none) tokenStart = offset;
+            kind = LexToken::Kind::STRING;
             continue;
         }
 
         // Check if the character is part of a word (letters, digits, underscore, period), the first is allowed to be a hashtag for color literals
-        if (std::isalnum(currentChar) || currentChar == '_' || currentChar == '.' || (currentToken.empty() && currentChar == '#'))
-            currentToken += currentChar;
-        else {
+        if (ByteScan::isWord(currentChar) || (tokenStart == none && currentChar == '#')) {
+            if (tokenStart == none) {
+                tokenStart = offset;
+                kind = LexToken::Kind::WORD;
+            }
+            i = ByteScan::skipWord(chunk, i + 1) - 1;
+        } else {
             // If we have a current token, push it to tokens
-            if (!currentToken.empty()) {
-                tokens.push_back(std::make_tuple(currentToken, line, pos));
-                currentToken.clear(); // Reset current token
+            if (tokenStart != none) {
+                push(tokenStart, offset, kind);
+                tokenStart = none; // Reset current token
             }
 
-            // If the character is not whitespace, add it as a standalone symbol token
-            if (!std::isspace(currentChar)) tokens.push_back(std::make_tuple(std::string(1, currentChar), line, pos));
+            // If the character is not whitespace, add it as a standalone symbol token,
+                    // a whole UTF-8 character is one symbol so that '≥' and the like can be operators
+            if (ByteScan::isSpace(currentChar)) i = ByteScan::skipBlank(chunk, i + 1) - 1;
+            else if ((uint8_t)currentChar < 0x80) push(offset, offset + 1, LexToken::Kind::SYMBOL);
+            else {
+                i += utf8Continuations(chunk, i);
+                push(offset, base + (uint32_t)i + 1, LexToken::Kind::SYMBOL);
+            }
         }
     }
 
+    state.offset = base + (uint32_t)chunk.length();
+    state.tokenStart = tokenStart;
+    state.kind = kind;
+    state.inString = inString;
+    state.inComment = inComment;
+    if (!chunk.empty()) state.previous = chunk.back();
+}
+
+void TokenParser::lexFinish(LexState& state, std::vector<LexToken>& out) {
     // Add the last token if it exists
-    if (!currentToken.empty()) tokens.push_back(std::make_tuple(currentToken, line, pos));
-}
\ No newline at end of file
+    if (state.tokenStart != LexState::none)
+        out.push_back(LexToken{state.tokenStart, state.offset - state.tokenStart, state.kind});
+    state.tokenStart = LexState::none;
+}
@@ -7,18 +7,90 @@ PURPOSE:
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <cstddef>
 #include <cstdint>
 
+// A token as a span of the source text, the text itself stays in the buffer the caller owns
+struct LexToken {
+    enum class Kind : uint8_t {
+        WORD,
+        SYMBOL,
+        STRING // Includes the quote marks, an unterminated string runs to the end of the text
+    };
+
+    uint32_t offset, length; // Lines and columns are left to SourceLines, for when they are shown
+    Kind kind;
+
+    std::string_view text(std::string_view source) const {
+        return source.substr(offset, length);
+    }
+};
+
+// Everything the lexer needs to carry on where it left off, so text can be lexed a piece at a time
+struct LexState {
+    static constexpr uint32_t none = (uint32_t)-1;
+
+    uint32_t offset = 0; // Position of the next character, token offsets are counted from where the state started
+    uint32_t tokenStart = none; // Start of the token being built, only a string is ever still open at a line break
+    LexToken::Kind kind = LexToken::Kind::WORD;
+    bool inString = false;
+    bool inComment = false; // Comments always end at a line break, it is only set partway through a line
+    char previous = 0;
+
+    bool operator==(const LexState& other) const = default;
+};
+
 class TokenParser {
 public:
+    // Text at least this long is split at line breaks and lexed on every core
+    static constexpr size_t defaultParallelThreshold = 4 << 20;
+
     TokenParser();
-    std::vector<std::tuple<std::string, uint32_t, uint32_t>> parse(const std::string& text);
-    std::vector<std::tuple<std::string, uint32_t, uint32_t>> getTokens() const;
+    // 0 never lexes in parallel
+    void setParallelThreshold(size_t bytes);
+    // How many pieces parallel lexing splits the text into, 0 for one per core
+    void setThreads(unsigned threads);
+    // The tokens point into text, so it has to outlive them
+    const std::vector<LexToken>& lex(std::string_view text);
+    const std::vector<LexToken>& getTokens() const;
+    // Copies every token out into its own string along with its offset, prefer lex() where the text can be kept alive
+    std::vector<std::tuple<std::string, uint32_t>> parse(const std::string& text);
+
+    // Lexes the next piece of text carrying on from state, finished tokens are added to out and an unfinished one is left in state,
+            // pieces have to be split between UTF-8 characters since each character outside ASCII is a symbol of its own
+    static void lexChunk(std::string_view chunk, LexState& state, std::vector<LexToken>& out);
+    // Adds the token still being built at the end of the text, if any
+    static void lexFinish(LexState& state, std::vector<LexToken>& out);
+
+private:
+    std::vector<LexToken> tokens;
+    size_t parallelThreshold = defaultParallelThreshold;
+    unsigned threads = 0;
+    void tokenize(std::string_view text);
+    // The same tokens as lexing it in one go, each piece is lexed as if it started outside a string and as if inside one
+    void tokenizeParallel(std::string_view text, unsigned pieces);
+};
+
+// Hands out the tokens of a text one at a time, lexing a window of it whenever the last one runs out,
+        // so whatever pulls from it works on tokens still in cache and nothing grows with the size of the text
+class LexCursor {
+public:
+    // Bytes lexed at a time, carried on to the next line break so a "//" is never split between windows
+    static constexpr size_t windowBytes = 4096;
+
+    // The text has to outlive the cursor and the tokens it gives
+    explicit LexCursor(std::string_view text);
+    // Gives false once every token has been handed out
+    bool next(LexToken& token);
 
 private:
-    std::vector<std::tuple<std::string, uint32_t, uint32_t>> tokens;
-    void tokenize(const std::string& text);
+    std::string_view text;
+    LexState state;
+    std::vector<LexToken> window;
+    size_t index = 0;
+    bool finished = false;
 };
 
 #endif // TOKENPARSER_H